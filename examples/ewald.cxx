@@ -35,9 +35,9 @@ int main(int argc, char ** argv) {
   Dataset data;
   Ewald ewald(ksize, alpha, sigma, cutoff, cycle);
   Partition partition(baseMPI.mpirank, baseMPI.mpisize);
-  Traversal traversal(args.nspawn, args.images, eps2);
+  Traversal traversal(args.nspawn, args.images, eps2, args.listM2L);
   TreeMPI treeMPI(baseMPI.mpirank, baseMPI.mpisize, args.images);
-  UpDownPass upDownPass(args.theta, args.useRmax, args.useRopt);
+  UpDownPass upDownPass(args.theta, args.useRmax, args.useRopt, args.errorBudget);
   Verify verify;
   num_threads(args.threads);
 
@@ -115,9 +115,8 @@ int main(int argc, char ** argv) {
     logger::stopTimer("Total Ewald");
 #else
     jbodies = bodies;
-    const int numTargets = 100;
     buffer = bodies;
-    data.sampleBodies(bodies, numTargets);
+    data.sampleBodies(bodies, args.numTargets);
     bodies2 = bodies;
     data.initTarget(bodies);
     logger::startTimer("Total Direct");
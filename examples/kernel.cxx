@@ -8,6 +8,7 @@ int main() {
   vec3 Xperiodic = 0;
   const real_t theta = 0.5;
   const real_t R = 2 / theta;
+  for (C_iter C=cells.begin(); C!=cells.end(); C++) C->ORDER = P;
 
   for (B_iter B=jbodies.begin(); B!=jbodies.end(); B++) {
     B->X[0] = 2 * drand48();
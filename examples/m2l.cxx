@@ -0,0 +1,56 @@
+#include <fstream>
+#include "kernel.h"
+#include "logger.h"
+#include <vector>
+
+int main(int argc, char ** argv) {
+  const int numCells = 1000;
+  const int numPairs = argc > 1 ? atoi(argv[1]) : 2000000;
+  Cells cells(2 * numCells);
+  vec3 Xperiodic = 0;
+
+  srand48(0);
+  for (C_iter C=cells.begin(); C!=cells.end(); C++) {
+    for (int d=0; d<3; d++) C->X[d] = int(drand48() * 4);
+    if (C-cells.begin() >= numCells) C->X[0] += 4;
+    for (int i=0; i<NTERM; i++) C->M[i] = drand48();
+    C->ORDER = P;
+    C->L = 0;
+  }
+  C_iter Ci0 = cells.begin();
+  C_iter Cj0 = cells.begin() + numCells;
+
+  for (int i=0; i<numCells; i++) {
+    kernel::M2L(Ci0+i, Cj0+i, Xperiodic, false);
+  }
+  for (C_iter C=Ci0; C!=Cj0; C++) C->L = 0;
+  double tic = logger::get_time();
+  for (int n=0; n<numPairs; n++) {
+    kernel::M2L(Ci0+n%numCells, Cj0+(n*7)%numCells, Xperiodic, false);
+  }
+  double toc = logger::get_time();
+  double check = 0;
+  for (C_iter C=Ci0; C!=Cj0; C++) check += std::abs(C->L[0]);
+
+  std::vector<std::vector<C_iter> > lists(numCells);
+  for (int n=0; n<numPairs; n++) {
+    lists[n%numCells].push_back(Cj0+(n*7)%numCells);
+  }
+  std::vector<vec3> Xperiodics(numPairs / numCells + 1, Xperiodic);
+  for (C_iter C=Ci0; C!=Cj0; C++) C->L = 0;
+  double tic2 = logger::get_time();
+  for (int i=0; i<numCells; i++) {
+    kernel::M2L(Ci0+i, &lists[i][0], &Xperiodics[0], lists[i].size());
+  }
+  double toc2 = logger::get_time();
+  double check2 = 0;
+  for (C_iter C=Ci0; C!=Cj0; C++) check2 += std::abs(C->L[0]);
+
+  std::fstream file;
+  file.open("m2l.dat", std::ios::out | std::ios::app);
+  std::cout << P << " " << NTERM << " " << numPairs / (toc - tic) << " M2L/s (" << check << ") "
+            << numPairs / (toc2 - tic2) << " batched M2L/s (" << check2 << ")" << std::endl;
+  file << P << " " << NTERM << " " << numPairs / (toc - tic) << " " << numPairs / (toc2 - tic2) << std::endl;
+  file.close();
+  return 0;
+}
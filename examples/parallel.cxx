@@ -18,14 +18,14 @@ int main(int argc, char ** argv) {
   Bodies bodies, bodies2, jbodies, gbodies, buffer;
   BoundBox boundBox(args.nspawn);
   Bounds localBounds, globalBounds;
-  BuildTree localTree(args.ncrit, args.nspawn);
+  BuildTree localTree(args.ncrit, args.nspawn, args.useHilbert);
   BuildTree globalTree(1, args.nspawn);
   Cells cells, jcells, gcells;
   Dataset data;
   Partition partition(baseMPI.mpirank, baseMPI.mpisize);
-  Traversal traversal(args.nspawn, args.images, eps2);
+  Traversal traversal(args.nspawn, args.images, eps2, args.listM2L);
   TreeMPI treeMPI(baseMPI.mpirank, baseMPI.mpisize, args.images);
-  UpDownPass upDownPass(args.theta, args.useRmax, args.useRopt);
+  UpDownPass upDownPass(args.theta, args.useRmax, args.useRopt, args.errorBudget);
   Verify verify;
   num_threads(args.threads);
 
@@ -49,6 +49,7 @@ int main(int argc, char ** argv) {
 #endif
   for (int t=0; t<args.repeat; t++) {
     logger::printTitle("FMM Profiling");
+    traversal.resetTraversalData();
     logger::startTimer("Total FMM");
     logger::startPAPI();
     localBounds = boundBox.getBounds(bodies);
@@ -56,10 +57,12 @@ int main(int argc, char ** argv) {
     localBounds = boundBox.getBounds(jbodies, localBounds);
 #endif
     globalBounds = baseMPI.allreduceBounds(localBounds);
-    partition.bisection(bodies, globalBounds);
+    if (args.useHilbert) partition.sfcsection(bodies, globalBounds, true);
+    else partition.bisection(bodies, globalBounds);
     bodies = treeMPI.commBodies(bodies);
 #if IneJ
-    partition.bisection(jbodies, globalBounds);
+    if (args.useHilbert) partition.sfcsection(jbodies, globalBounds, true);
+    else partition.bisection(jbodies, globalBounds);
     jbodies = treeMPI.commBodies(jbodies);
 #endif
     localBounds = boundBox.getBounds(bodies);
@@ -127,9 +130,8 @@ int main(int argc, char ** argv) {
     logger::stopTimer("Total FMM", 0);
 #if DIRECT
     logger::printTitle("MPI direct sum");
-    const int numTargets = 100;
     buffer = bodies;
-    data.sampleBodies(bodies, numTargets);
+    data.sampleBodies(bodies, args.numTargets);
     bodies2 = bodies;
     data.initTarget(bodies);
     logger::startTimer("Total Direct");
@@ -163,6 +165,7 @@ int main(int argc, char ** argv) {
 #endif
     logger::resetTimer("Total FMM");
 #if WRITE_TIME
+    traversal.writeTraversalData(baseMPI.mpirank);
     logger::writeTime(baseMPI.mpirank);
 #endif
   }
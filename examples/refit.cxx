@@ -0,0 +1,113 @@
+#include "args.h"
+#include "bound_box.h"
+#include "build_tree.h"
+#include "dataset.h"
+#include "logger.h"
+#include "refit_tree.h"
+#include "traversal.h"
+#include "up_down_pass.h"
+#include "verify.h"
+
+//! Copy bodies into the order of their initial numbering
+void sortBodies(Bodies & bodies, Bodies & sorted) {
+  sorted.resize(bodies.size());
+  for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {
+    sorted[B->IBODY] = *B;
+  }
+}
+
+//! Clear target values but keep the initial numbering
+void clearTarget(Bodies & bodies) {
+  for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {
+    B->TRG = 0;
+  }
+}
+
+int main(int argc, char ** argv) {
+  const real_t eps2 = 0.0;
+  const real_t cycle = 2 * M_PI;
+  const int numSteps = 10;
+  Args args(argc, argv);
+  Bodies bodies, bodies2, jbodies, buffer, refitBodies, rebuildBodies;
+  BoundBox boundBox(args.nspawn);
+  Bounds bounds, rebuildBounds;
+  BuildTree buildTree(args.ncrit, args.nspawn, args.useHilbert);
+  Cells cells, rebuildCells;
+  Dataset data;
+  RefitTree refitTree(args.ncrit);
+  Traversal traversal(args.nspawn, args.images, eps2, args.listM2L);
+  UpDownPass upDownPass(args.theta, args.useRmax, args.useRopt, args.errorBudget);
+  Verify verify;
+  num_threads(args.threads);
+
+  logger::verbose = args.verbose;
+  logger::printTitle("FMM Parameters");
+  args.print(logger::stringLength, P);
+  refitBodies = data.initBodies(args.numBodies, args.distribution, 0);
+  data.initTarget(refitBodies);
+  std::vector<vec3> velocity(refitBodies.size());
+  real_t dt = .05 * cycle / std::pow(real_t(refitBodies.size()), real_t(1./3));
+  for (size_t i=0; i<velocity.size(); i++) {
+    for (int d=0; d<3; d++) velocity[i][d] = drand48() * 2 - 1;
+  }
+  bounds = boundBox.getBounds(refitBodies);
+  cells = buildTree.buildTree(refitBodies, buffer, bounds);
+  int numRebuilds = 0;
+  bool pass = true;
+  for (int t=0; t<numSteps; t++) {
+    for (B_iter B=refitBodies.begin(); B!=refitBodies.end(); B++) {
+      B->X += velocity[B->IBODY] * dt;
+    }
+    clearTarget(refitBodies);
+    rebuildBodies = refitBodies;
+
+    logger::printTitle("Rebuild");
+    logger::startTimer("Total FMM");
+    rebuildBounds = boundBox.getBounds(rebuildBodies);
+    rebuildCells = buildTree.buildTree(rebuildBodies, buffer, rebuildBounds);
+    upDownPass.upwardPass(rebuildCells);
+    traversal.dualTreeTraversal(rebuildCells, rebuildCells, cycle, args.mutual);
+    upDownPass.downwardPass(rebuildCells);
+    logger::stopTimer("Total FMM");
+    logger::resetTimer("Total FMM");
+
+    logger::printTitle("Refit");
+    logger::startTimer("Total FMM");
+    if (!refitTree.refitTree(refitBodies, buffer, cells, bounds)) {
+      cells = buildTree.buildTree(refitBodies, buffer, bounds);
+      numRebuilds++;
+    }
+    upDownPass.upwardPass(cells);
+    traversal.dualTreeTraversal(cells, cells, cycle, args.mutual);
+    upDownPass.downwardPass(cells);
+    logger::stopTimer("Total FMM");
+    logger::resetTimer("Total FMM");
+    refitTree.printRefitData();
+
+    sortBodies(refitBodies, bodies);
+    sortBodies(rebuildBodies, bodies2);
+    jbodies = bodies;
+    data.sampleBodies(bodies, args.numTargets);
+    data.sampleBodies(bodies2, args.numTargets);
+    buffer = bodies;
+    clearTarget(buffer);
+    traversal.direct(buffer, jbodies, cycle);
+    traversal.normalize(buffer);
+    double potRefit = std::sqrt(verify.getDifScalar(buffer, bodies) / verify.getNrmScalar(buffer));
+    double accRefit = std::sqrt(verify.getDifVector(buffer, bodies) / verify.getNrmVector(buffer));
+    double potRebuild = std::sqrt(verify.getDifScalar(buffer, bodies2) / verify.getNrmScalar(buffer));
+    double accRebuild = std::sqrt(verify.getDifVector(buffer, bodies2) / verify.getNrmVector(buffer));
+    logger::printTitle("Refit vs. rebuild");
+    verify.print("Rebuild error (pot)", potRebuild);
+    verify.print("Refit error (pot)", potRefit);
+    verify.print("Rebuild error (acc)", accRebuild);
+    verify.print("Refit error (acc)", accRefit);
+    pass &= potRefit <= 2 * potRebuild && accRefit <= 2 * accRebuild;
+  }
+  logger::printTitle("Refit summary");
+  std::cout << std::setw(logger::stringLength) << std::left
+	    << "Rebuilds" << " : " << numRebuilds << " / " << numSteps << std::endl
+	    << std::setw(logger::stringLength) << std::left
+	    << "Refit accuracy" << " : " << (pass ? "OK" : "FAILED") << std::endl;
+  return pass ? 0 : 1;
+}
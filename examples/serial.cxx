@@ -14,11 +14,11 @@ int main(int argc, char ** argv) {
   Bodies bodies, bodies2, jbodies, buffer;
   BoundBox boundBox(args.nspawn);
   Bounds bounds;
-  BuildTree buildTree(args.ncrit, args.nspawn);
+  BuildTree buildTree(args.ncrit, args.nspawn, args.useHilbert);
   Cells cells, jcells;
   Dataset data;
-  Traversal traversal(args.nspawn, args.images, eps2);
-  UpDownPass upDownPass(args.theta, args.useRmax, args.useRopt);
+  Traversal traversal(args.nspawn, args.images, eps2, args.listM2L);
+  UpDownPass upDownPass(args.theta, args.useRmax, args.useRopt, args.errorBudget);
   Verify verify;
   num_threads(args.threads);
 
@@ -40,6 +40,7 @@ int main(int argc, char ** argv) {
 #endif
   for (int t=0; t<args.repeat; t++) {
     logger::printTitle("FMM Profiling");
+    traversal.resetTraversalData();
     logger::startTimer("Total FMM");
     logger::startPAPI();
     logger::startDAG();
@@ -52,9 +53,11 @@ int main(int argc, char ** argv) {
 #if IneJ
     jcells = buildTree.buildTree(jbodies, buffer, bounds);
     upDownPass.upwardPass(jcells);
-    traversal.dualTreeTraversal(cells, jcells, cycle, false);
+    if (args.groupSize) traversal.groupTraversal(cells, jcells, cycle, args.groupSize);
+    else traversal.dualTreeTraversal(cells, jcells, cycle, false);
 #else
-    traversal.dualTreeTraversal(cells, cells, cycle, args.mutual);
+    if (args.groupSize) traversal.groupTraversal(cells, cells, cycle, args.groupSize);
+    else traversal.dualTreeTraversal(cells, cells, cycle, args.mutual);
     jbodies = bodies;
 #endif
     upDownPass.downwardPass(cells);
@@ -64,15 +67,20 @@ int main(int argc, char ** argv) {
     logger::stopTimer("Total FMM");
     logger::resetTimer("Total FMM");
 #if WRITE_TIME
+    traversal.writeTraversalData();
     logger::writeTime();
 #endif
-    const int numTargets = 100;
     buffer = bodies;
-    data.sampleBodies(bodies, numTargets);
+    data.sampleBodies(bodies, args.numTargets);
     bodies2 = bodies;
     data.initTarget(bodies);
     logger::startTimer("Total Direct");
+#if IneJ
     traversal.direct(bodies, jbodies, cycle);
+#else
+    if (bodies.size() == jbodies.size()) traversal.direct(bodies, bodies, cycle, args.mutual);
+    else traversal.direct(bodies, jbodies, cycle);
+#endif
     traversal.normalize(bodies);
     logger::stopTimer("Total Direct");
     double potDif = verify.getDifScalar(bodies, bodies2);
@@ -9,7 +9,7 @@ int main(int argc, char ** argv) {
   Bodies bodies, bodies2, jbodies, buffer;
   BoundBox boundBox(args.nspawn);
   Bounds bounds;
-  BuildTree buildTree(args.ncrit, args.nspawn);
+  BuildTree buildTree(args.ncrit, args.nspawn, args.useHilbert);
   Cells cells, jcells;
   Dataset data;
   num_threads(args.threads);
@@ -15,7 +15,12 @@ static struct option long_options[] = {
   {"theta",        1, 0, 't'},
   {"useRmax",      1, 0, 'x'},
   {"useRopt",      1, 0, 'o'},
+  {"errorBudget",  1, 0, 'e'},
+  {"useHilbert",   1, 0, 'u'},
   {"mutual",       1, 0, 'm'},
+  {"listM2L",      1, 0, 'l'},
+  {"groupSize",    1, 0, 'G'},
+  {"numTargets",   1, 0, 'S'},
   {"graft",        1, 0, 'g'},
   {"verbose",      1, 0, 'v'},
   {"distribution", 1, 0, 'd'},
@@ -34,7 +39,12 @@ public:
   double theta;
   int useRmax;
   int useRopt;
+  double errorBudget;
+  int useHilbert;
   int mutual;
+  int listM2L;
+  int groupSize;
+  int numTargets;
   int graft;
   int verbose;
   const char * distribution;
@@ -53,7 +63,14 @@ private:
             " --theta (-t)                  : Multipole acceptance criterion (%f)\n"
 	    " --useRmax (-x) [0/1]          : Use maximum distance for MAC (%d)\n"
 	    " --useRopt (-o) [0/1]          : Use error optimized theta for MAC (%d)\n"
+            " --errorBudget (-e)            : Relative error per cell for variable expansion order, 0 for fixed order (%g)\n"
+            "                                 (Spherical and Rotation only)\n"
+	    " --useHilbert (-u) [0/1]       : Use Hilbert instead of Morton order for tree and partition (%d)\n"
             " --mutual (-m) [0/1]           : Use mutual interaction (%d)\n"
+            " --listM2L (-l) [0/1]          : Record M2L lists and evaluate them in SIMD batches (%d)\n"
+            " --groupSize (-G)              : Bodies per target group of the group traversal, 0 for dual tree traversal (%d)\n"
+            "                                 (the group MAC is looser: use -t 0.3 for the error of the default theta)\n"
+            " --numTargets (-S)             : Number of sampled targets for direct summation, 0 for all (%d)\n"
 	    " --graft (-g) [0/1]            : Graft remote trees to global tree (%d)\n"
 	    " --verbose (-v) [0/1]          : Print information to screen (%d)\n"
             " --distribution (-d) [l/c/s/p] : lattice, cube, sphere, octant, plummer (%s)\n"
@@ -68,7 +85,12 @@ private:
             theta,
 	    useRmax,
 	    useRopt,
+            errorBudget,
+	    useHilbert,
             mutual,
+            listM2L,
+            groupSize,
+            numTargets,
 	    graft,
 	    verbose,
             distribution,
@@ -96,11 +118,11 @@ private:
 
 public:
   Args(int argc=0, char ** argv=NULL) : numBodies(1000000), ncrit(16), nspawn(1000), threads(16), images(0),
-					theta(.4), useRmax(1), useRopt(1), mutual(1), graft(1),
+					theta(.4), useRmax(1), useRopt(1), errorBudget(0), useHilbert(0), mutual(1), listM2L(0), groupSize(0), numTargets(100), graft(1),
 					verbose(1), distribution("cube"), repeat(1) {
     while (1) {
       int option_index;
-      int c = getopt_long(argc, argv, "n:c:s:T:i:t:x:o:m:g:v:d:r:h", long_options, &option_index);
+      int c = getopt_long(argc, argv, "n:c:s:T:i:t:x:o:e:u:m:l:G:S:g:v:d:r:h", long_options, &option_index);
       if (c == -1) break;
       switch (c) {
       case 'n':
@@ -127,9 +149,30 @@ public:
       case 'o':
         useRopt = atof(optarg);
         break;
+      case 'e':
+        errorBudget = atof(optarg);
+#if Cartesian
+        if (errorBudget > 0) {
+          fprintf(stderr, "--errorBudget needs a basis that honours Cell::ORDER (Spherical or Rotation)\n");
+          exit(1);
+        }
+#endif
+        break;
+      case 'u':
+        useHilbert = atoi(optarg);
+        break;
       case 'm':
         mutual = atoi(optarg);
         break;
+      case 'l':
+        listM2L = atoi(optarg);
+        break;
+      case 'G':
+        groupSize = atoi(optarg);
+        break;
+      case 'S':
+        numTargets = atoi(optarg);
+        break;
       case 'g':
 	graft = atoi(optarg);
 	break;
@@ -173,8 +216,18 @@ public:
 		<< std::setw(stringLength)                      //  Set format
 		<< "useRopt" << " : " << useRopt << std::endl   //  Print useRopt
 		<< std::setw(stringLength)                      //  Set format
+		<< "errorBudget" << " : " << errorBudget << std::endl// Print errorBudget
+		<< std::setw(stringLength)                      //  Set format
+		<< "useHilbert" << " : " << useHilbert << std::endl// Print useHilbert
+		<< std::setw(stringLength)                      //  Set format
 		<< "mutual" << " : " << mutual << std::endl     //  Print mutual
 		<< std::setw(stringLength)                      //  Set format
+		<< "listM2L" << " : " << listM2L << std::endl   //  Print listM2L
+		<< std::setw(stringLength)                      //  Set format
+		<< "groupSize" << " : " << groupSize << std::endl// Print groupSize
+		<< std::setw(stringLength)                      //  Set format
+		<< "numTargets" << " : " << numTargets << std::endl// Print numTargets
+		<< std::setw(stringLength)                      //  Set format
 		<< "graft" << " : " << graft << std::endl       //  Print graft
 		<< std::setw(stringLength)                      //  Set format
 		<< "verbose" << " : " << verbose << std::endl   //  Print verbose
@@ -0,0 +1,54 @@
+#ifndef bodies_soa_h
+#define bodies_soa_h
+#include "types.h"
+
+/*! Structure of arrays for the body fields touched by P2P (positions, sources, targets)
+
+  The streams are a per-traversal copy: Traversal scatters the bodies of its leaf cells before
+  the traversal and gathers the targets afterwards. With USE_SOA the kernel::P2P overloads read
+  and write only the streams, so callers outside Traversal must scatter() the cells first and
+  gather() them afterwards (the kernels assert Cell::SOA != NULL). */
+struct BodiesSoA {
+  typedef std::vector<real_t,AlignedAllocator<real_t,SIMD_BYTES> >   RealVec; //!< Aligned stream of real_t
+  typedef std::vector<kreal_t,AlignedAllocator<kreal_t,SIMD_BYTES> > KRealVec;//!< Aligned stream of kreal_t
+  RealVec  X[3];                                                //!< Position streams
+  RealVec  SRC;                                                 //!< Scalar source stream
+  KRealVec TRG[4];                                              //!< Scalar+vector3 target streams
+
+  //! Copy bodies of leaf cells into the streams in tree order (each leaf starts on a SIMD boundary)
+  void scatter(Cells & cells) {
+    int n = 0;                                                  // Stream length including padding
+    for (C_iter C=cells.begin(); C!=cells.end(); C++) {         // Loop over cells
+      if (C->NCHILD == 0) {                                     //  If leaf cell
+	C->SOA = this;                                          //   Link cell to streams
+	C->ISOA = n;                                            //   Index of first body in streams
+	n += (C->NBODY + NSIMD - 1) / NSIMD * NSIMD;            //   Pad to multiple of SIMD width
+      }                                                         //  End if for leaf cell
+    }                                                           // End loop over cells
+    for (int d=0; d<3; d++) X[d].assign(n, 0);                  // Reset position streams (padding stays zero)
+    SRC.assign(n, 0);                                           // Reset source stream (zero source masks padding)
+    for (int d=0; d<4; d++) TRG[d].assign(n, 0);                // Reset target streams
+    for (C_iter C=cells.begin(); C!=cells.end(); C++) {         // Loop over cells
+      if (C->NCHILD == 0) {                                     //  If leaf cell
+	B_iter B = C->BODY;                                     //   Iterator of first body
+	for (int i=C->ISOA; i<C->ISOA+C->NBODY; i++,B++) {      //   Loop over bodies in cell
+	  for (int d=0; d<3; d++) X[d][i] = B->X[d];            //    Copy position
+	  SRC[i] = B->SRC;                                      //    Copy source
+	}                                                       //   End loop over bodies in cell
+      }                                                         //  End if for leaf cell
+    }                                                           // End loop over cells
+  }
+
+  //! Add target values in the streams back to the bodies of leaf cells
+  void gather(Cells & cells) {
+    for (C_iter C=cells.begin(); C!=cells.end(); C++) {         // Loop over cells
+      if (C->NCHILD == 0 && C->SOA == this) {                   //  If leaf cell is linked to these streams
+	B_iter B = C->BODY;                                     //   Iterator of first body
+	for (int i=C->ISOA; i<C->ISOA+C->NBODY; i++,B++) {      //   Loop over bodies in cell
+	  for (int d=0; d<4; d++) B->TRG[d] += TRG[d][i];       //    Accumulate target values
+	}                                                       //   End loop over bodies in cell
+      }                                                         //  End if for leaf cell
+    }                                                           // End loop over cells
+  }
+};
+#endif
@@ -2,6 +2,7 @@
 #define build_tree_h
 #include <algorithm>
 #include "logger.h"
+#include "sfc.h"
 #include "thread.h"
 #include "types.h"
 
@@ -117,7 +118,12 @@ static const int morton256_z[256] = {
 class BuildTree {
 private:
   const int ncrit;
+  const int useHilbert;
   int maxlevel;
+  std::vector<uint64_t> keys;                                   //!< Keys of bodies (kept across builds)
+  std::vector<uint64_t> keysBuffer;                             //!< Buffer for radix sort (kept across builds)
+  std::vector<int> index;                                       //!< Sort index of bodies (kept across builds)
+  std::vector<int> permutation;                                 //!< Permutation buffer (kept across builds)
 
 private:
   Box bounds2box(Bounds & bounds) {
@@ -146,18 +152,23 @@ private:
       int ix = floor((X[0] - bounds.Xmin[0]) / d);
       int iy = floor((X[1] - bounds.Xmin[1]) / d);
       int iz = floor((X[2] - bounds.Xmin[2]) / d);
-      uint64_t key =
-        morton256_x[(ix >> 16) & 0xFF] |
-        morton256_y[(iy >> 16) & 0xFF] |
-        morton256_z[(iz >> 16) & 0xFF];
-      key = key << 48 |
-        morton256_x[(ix >> 8) & 0xFF] |
-        morton256_y[(iy >> 8) & 0xFF] |
-        morton256_z[(iz >> 8) & 0xFF];
-      key = key << 24 |
-        morton256_x[ix & 0xFF] |
-        morton256_y[iy & 0xFF] |
-        morton256_z[iz & 0xFF];
+      uint64_t key;
+      if (useHilbert) {
+	key = sfc::hilbert(ix, iy, iz, maxlevel);
+      } else {
+	key =
+	  morton256_x[(ix >> 16) & 0xFF] |
+	  morton256_y[(iy >> 16) & 0xFF] |
+	  morton256_z[(iz >> 16) & 0xFF];
+	key = key << 48 |
+	  morton256_x[(ix >> 8) & 0xFF] |
+	  morton256_y[(iy >> 8) & 0xFF] |
+	  morton256_z[(iz >> 8) & 0xFF];
+	key = key << 24 |
+	  morton256_x[ix & 0xFF] |
+	  morton256_y[iy & 0xFF] |
+	  morton256_z[iz & 0xFF];
+      }
       B->ICELL = key;
       keys[b] = key;
       index[b] = b;
@@ -302,6 +313,9 @@ private:
 	cell.X[1]   = d * (iy + .5) + bounds.Xmin[1];
 	cell.X[2]   = d * (iz + .5) + bounds.Xmin[2];
 	cell.R      = d * .5;
+#if USE_SOA
+	cell.SOA    = NULL;
+#endif
 	cells.push_back(cell);
 	C = cells.end()-1;
 	I = IC;
@@ -336,6 +350,9 @@ private:
 	  cell.X[1]   = d * (iy + .5) + bounds.Xmin[1];
 	  cell.X[2]   = d * (iz + .5) + bounds.Xmin[2];
 	  cell.R      = d * .5;
+#if USE_SOA
+	  cell.SOA    = NULL;
+#endif
 	  cells.push_back(cell);
 	  p++;
 	  I = IC;
@@ -364,25 +381,27 @@ private:
   }
 
 public:
-  BuildTree(int _ncrit, int) : maxlevel(0), ncrit(_ncrit) {}
+  BuildTree(int _ncrit, int, int _useHilbert=0) : maxlevel(0), ncrit(_ncrit), useHilbert(_useHilbert) {}
 
   Cells buildTree(Bodies & bodies, Bodies & buffer, Bounds bounds) {
     const int numBodies = bodies.size();
     const int level = numBodies >= ncrit ? 1 + int(log(numBodies / ncrit)/M_LN2/3) : 0;
     maxlevel = level;
 
-    uint64_t * keys = new uint64_t [numBodies];
-    uint64_t * keys_buffer = new uint64_t [numBodies];
-    int * index = new int [numBodies];
-    int * permutation = new int [numBodies];
+    if (int(keys.size()) < std::max(numBodies, 1)) {            // Grow scratch buffers only when needed
+      keys.resize(std::max(numBodies, 1));
+      keysBuffer.resize(std::max(numBodies, 1));
+      index.resize(std::max(numBodies, 1));
+      permutation.resize(std::max(numBodies, 1));
+    }
 
     logger::startTimer("Grow tree");
-    logger::startTimer("Morton key");
-    getKey(bodies, bounds, keys, index);
-    logger::stopTimer("Morton key");
+    logger::startTimer("SFC key");
+    getKey(bodies, bounds, &keys[0], &index[0]);
+    logger::stopTimer("SFC key");
 
     logger::startTimer("Radix sort");
-    radixSort(keys, keys_buffer, permutation, index, numBodies);
+    radixSort(&keys[0], &keysBuffer[0], &permutation[0], &index[0], numBodies);
     logger::stopTimer("Radix sort");
     logger::stopTimer("Grow tree",0);
 
@@ -392,7 +411,7 @@ public:
 
     logger::startTimer("Grow tree");
     logger::startTimer("Permutation");
-    permute(bodies, buffer, permutation);
+    permute(bodies, buffer, &permutation[0]);
     logger::stopTimer("Permutation");
     logger::stopTimer("Grow tree",0);
 
@@ -408,15 +427,11 @@ public:
     logger::stopTimer("Leafs to cells");
 
     logger::startTimer("Reverse order");
-    reverseOrder(cells, permutation);
+    if (permutation.size() < cells.size()) permutation.resize(cells.size());
+    reverseOrder(cells, &permutation[0]);
     logger::stopTimer("Reverse order");
     logger::stopTimer("Link tree",0);
 #endif
-
-    delete[] keys;
-    delete[] keys_buffer;
-    delete[] index;
-    delete[] permutation;
     return cells;
   }
 
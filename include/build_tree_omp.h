@@ -2,6 +2,7 @@
 #define build_tree_h
 #include <algorithm>
 #include "logger.h"
+#include "sfc.h"
 #include "thread.h"
 #include "types.h"
 #ifndef _OPENMP
@@ -14,7 +15,14 @@ int omp_get_thread_num() {return 0;}
 class BuildTree {
 private:
   const int ncrit;
+  const int useHilbert;
   int maxlevel;
+  std::vector<uint64_t> key;                                    //!< Keys of bodies (kept across builds)
+  std::vector<uint64_t> keyBuffer;                              //!< Buffer for radix sort (kept across builds)
+  std::vector<int> index;                                       //!< Sort index of bodies (kept across builds)
+  std::vector<int> permutation;                                 //!< Permutation buffer (kept across builds)
+  std::vector<int> bucketBuffer;                                //!< Radix sort buckets per thread (kept across builds)
+  std::vector<uint64_t> maxKeyBuffer;                           //!< Maximum key per thread (kept across builds)
 
 private:
   //! Transform Xmin & Xmax to X (center) & R (radius)
@@ -32,7 +40,7 @@ private:
     return box;                                                 // Return box.X and box.R
   }
 
-  //! Calculate the Morton key
+  //! Calculate the Morton or Hilbert key
   inline void getKey(Bodies &bodies, uint64_t * key, Bounds bounds, int level) {
     Box box = bounds2box(bounds);
     float d = 2 * box.R / (1 << level);                         // Cell size at current level
@@ -42,17 +50,9 @@ private:
       int ix = (B->X[0] - bounds.Xmin[0]) / d;                  //  Index in x dimension
       int iy = (B->X[1] - bounds.Xmin[1]) / d;                  //  Index in y dimension
       int iz = (B->X[2] - bounds.Xmin[2]) / d;                  //  Index in z dimension
-      int id = 0;                                               //  Initialize Morton key
-      for( int l=0; l!=level; ++l ) {                           //  Loop over levels
-	id += (ix & 1) << (3 * l);                              //   Interleave x bit
-	id += (iy & 1) << (3 * l + 1);                          //   Interleave y bit
-	id += (iz & 1) << (3 * l + 2);                          //   Interleave z bit
-	ix >>= 1;                                               //   Shift x index
-	iy >>= 1;                                               //   Shift y index
-	iz >>= 1;                                               //   Shift z index
-      }                                                         //  End loop over levels
-      key[b] = id;                                              //  Store Morton key in array
-      B->ICELL = id;                                            //  Store Morton key in body struct
+      uint64_t id = sfc::getKey(ix, iy, iz, level, useHilbert); //  Morton or Hilbert key
+      key[b] = id;                                              //  Store key in array
+      B->ICELL = id;                                            //  Store key in body struct
     }                                                           // End loop over bodies
   }
 
@@ -69,8 +69,10 @@ private:
       numThreads = omp_get_num_threads();
 #pragma omp single
       {
-	bucketPerThread = new int [numThreads][stride]();
-	maxKeyPerThread = new uint64_t [numThreads];
+	if (int(bucketBuffer.size()) < numThreads * stride) bucketBuffer.resize(numThreads * stride);
+	if (int(maxKeyBuffer.size()) < numThreads) maxKeyBuffer.resize(numThreads);
+	bucketPerThread = reinterpret_cast<int (*)[stride]>(&bucketBuffer[0]);
+	maxKeyPerThread = &maxKeyBuffer[0];
 	for (int i=0; i<numThreads; i++)
 	  maxKeyPerThread[i] = 0;
       }
@@ -116,8 +118,6 @@ private:
 	maxKey >>= bitStride;
       }
     }
-    delete[] bucketPerThread;
-    delete[] maxKeyPerThread;
   }
 
   void permute(Bodies & bodies, Bodies & buffer, int * index) {
@@ -149,6 +149,9 @@ private:
 	cell.X[1]   = d * (iy + .5) + bounds.Xmin[1];
 	cell.X[2]   = d * (iz + .5) + bounds.Xmin[2];
 	cell.R      = d * .5;
+#if USE_SOA
+	cell.SOA    = NULL;
+#endif
 	cells.push_back(cell);
 	C = cells.end()-1;
 	I = IC;
@@ -183,6 +186,9 @@ private:
 	  cell.X[1]   = d * (iy + .5) + bounds.Xmin[1];
 	  cell.X[2]   = d * (iz + .5) + bounds.Xmin[2];
 	  cell.R      = d * .5;
+#if USE_SOA
+	  cell.SOA    = NULL;
+#endif
 	  cells.push_back(cell);
 	  p++;
 	  I = IC;
@@ -211,27 +217,29 @@ private:
   }
 
 public:
-  BuildTree(int _ncrit, int) : maxlevel(0), ncrit(_ncrit) {}
+  BuildTree(int _ncrit, int, int _useHilbert=0) : maxlevel(0), ncrit(_ncrit), useHilbert(_useHilbert) {}
 
   Cells buildTree(Bodies & bodies, Bodies & buffer, Bounds bounds) {
     const int numBodies = bodies.size();
     const int level = numBodies >= ncrit ? 1 + int(log(numBodies / ncrit)/M_LN2/3) : 0;
     maxlevel = level;
-    uint64_t * key = new uint64_t [numBodies];
-    uint64_t * key_buffer = new uint64_t [numBodies];
-    int * index = new int [numBodies];
-    int * permutation = new int [numBodies];
+    if (int(key.size()) < std::max(numBodies, 1)) {             // Grow scratch buffers only when needed
+      key.resize(std::max(numBodies, 1));
+      keyBuffer.resize(std::max(numBodies, 1));
+      index.resize(std::max(numBodies, 1));
+      permutation.resize(std::max(numBodies, 1));
+    }
     Cells cells;
     for (int b=0; b<int(bodies.size()); b++) {
       index[b] = b;
     }
 
-    logger::startTimer("Morton key");
-    getKey(bodies, key, bounds, level);
-    logger::stopTimer("Morton key");
+    logger::startTimer("SFC key");
+    getKey(bodies, &key[0], bounds, level);
+    logger::stopTimer("SFC key");
 
     logger::startTimer("Radix sort");
-    radixSort(key, index, key_buffer, permutation, numBodies);
+    radixSort(&key[0], &index[0], &keyBuffer[0], &permutation[0], numBodies);
     logger::stopTimer("Radix sort");
 
     logger::startTimer("Copy buffer");
@@ -239,7 +247,7 @@ public:
     logger::stopTimer("Copy buffer");
 
     logger::startTimer("Permutation");
-    permute(bodies, buffer, index);
+    permute(bodies, buffer, &index[0]);
     logger::stopTimer("Permutation");
 
     logger::startTimer("Bodies to leafs");
@@ -251,13 +259,9 @@ public:
     logger::stopTimer("Leafs to cells");
 
     logger::startTimer("Reverse order");
-    reverseOrder(cells, permutation);
+    if (permutation.size() < cells.size()) permutation.resize(cells.size());
+    reverseOrder(cells, &permutation[0]);
     logger::stopTimer("Reverse order");
-
-    delete[] key;
-    delete[] key_buffer;
-    delete[] index;
-    delete[] permutation;
     return cells;
   }
 
@@ -1,6 +1,7 @@
 #ifndef build_tree_h
 #define build_tree_h
 #include "logger.h"
+#include "sfc.h"
 #include "thread.h"
 #include "types.h"
 
@@ -16,20 +17,14 @@ private:
     BinaryTreeNode * END;                                       //!< Pointer to end of memory space
   };
 
-  //! Octree is used for building the FMM tree structure as "nodes", then transformed to "cells" data structure
-  struct OctreeNode {
-    int          IBODY;                                         //!< Index offset for first body in node
-    int          NBODY;                                         //!< Number of descendant bodies
-    int          NNODE;                                         //!< Number of descendant nodes
-    OctreeNode * CHILD[8];                                      //!< Pointer to child node
-    vec3         X;                                             //!< Coordinate at center
-  };
-
   const int    ncrit;                                           //!< Number of bodies per leaf cell
   const int    nspawn;                                          //!< Threshold of NBODY for spawning new threads
+  const int    useHilbert;                                      //!< Order children along Hilbert curve instead of Morton
   int          maxlevel;                                        //!< Maximum level of tree
-  B_iter       B0;                                              //!< Iterator of first body
-  OctreeNode * N0;                                              //!< Pointer to octree root node
+  std::vector<BinaryTreeNode> binNodePool;                      //!< Binary tree node storage (kept across builds)
+  std::vector<ivec8> octantCount;                               //!< Bodies per octant of cells in a level (kept across builds)
+  std::vector<int> cellState;                                   //!< Space filling curve state of cells (kept across builds)
+  std::vector<int> rangeSum;                                    //!< Child count per range of cells (kept across builds)
 
 private:
   //! Recursive functor for counting bodies in each octant using binary tree
@@ -81,7 +76,7 @@ private:
     }                                                           // End overload operator()
   };
 
-  //! Recursive functor for sorting bodies according to octant (Morton order)
+  //! Recursive functor for sorting bodies according to octant (Morton or Hilbert order)
   struct MoveBodies {
     Bodies & bodies;                                            //!< Vector of bodies
     Bodies & buffer;                                            //!< Buffer for bodies
@@ -115,9 +110,8 @@ private:
     }                                                           // End overload operator()
   };
 
-  //! Recursive functor for building nodes of an octree adaptively using a top-down approach
-  struct BuildNodes {
-    OctreeNode *& octNode;                                      //!< Reference to a double pointer of an octree node
+  //! Recursive functor for sorting bodies into octants adaptively using a top-down approach
+  struct SortBodies {
     Bodies & bodies;                                            //!< Vector of bodies
     Bodies & buffer;                                            //!< Buffer for bodies
     int begin;                                                  //!< Body begin index
@@ -127,34 +121,25 @@ private:
     real_t R0;                                                  //!< Radius of root cell
     int ncrit;                                                  //!< Number of bodies per leaf cell
     int nspawn;                                                 //!< Threshold of NBODY for spawning new threads
-    logger::Timer & timer;
+    int useHilbert;                                             //!< Order children along Hilbert curve
     int level;                                                  //!< Current tree level
+    int state;                                                  //!< Space filling curve state of node
     bool direction;                                             //!< Direction of buffer copying
     //! Constructor
-    BuildNodes(OctreeNode *& _octNode, Bodies & _bodies,
-	       Bodies & _buffer, int _begin, int _end, BinaryTreeNode * _binNode,
-	       vec3 _X, real_t _R0, int _ncrit, int _nspawn, logger::Timer & _timer, int _level=0, bool _direction=false) :
-      octNode(_octNode), bodies(_bodies), buffer(_buffer),      // Initialize variables
+    SortBodies(Bodies & _bodies, Bodies & _buffer, int _begin, int _end, BinaryTreeNode * _binNode,
+	       vec3 _X, real_t _R0, int _ncrit, int _nspawn, int _useHilbert,
+	       int _level=0, int _state=0, bool _direction=false) :
+      bodies(_bodies), buffer(_buffer),                         // Initialize variables
       begin(_begin), end(_end), binNode(_binNode), X(_X), R0(_R0),
-      ncrit(_ncrit), nspawn(_nspawn), timer(_timer), level(_level), direction(_direction) {}
-    //! Create an octree node
-    OctreeNode * makeOctNode(int begin, int end, vec3 X, bool nochild) const {
-      OctreeNode * octNode = new OctreeNode();                  // Allocate memory for single node
-      octNode->IBODY = begin;                                   // Index of first body in node
-      octNode->NBODY = end - begin;                             // Number of bodies in node
-      octNode->NNODE = 1;                                       // Initialize counter for decendant nodes
-      octNode->X = X;                                           // Center coordinates of node
-      if (nochild) {                                            // If node has no children
-	for (int i=0; i<8; i++) octNode->CHILD[i] = NULL;       //  Initialize pointers to children
-      }                                                         // End if for node children
-      return octNode;                                           // Return node
-    }
-    //! Exclusive scan with offset
+      ncrit(_ncrit), nspawn(_nspawn), useHilbert(_useHilbert),
+      level(_level), state(_state), direction(_direction) {}
+    //! Exclusive scan with offset (in order of the space filling curve)
     inline ivec8 exclusiveScan(ivec8 input, int offset) const {
       ivec8 output;                                             // Output vector
       for (int i=0; i<8; i++) {                                 // Loop over elements
-	output[i] = offset;                                     //  Set value
-	offset += input[i];                                     //  Increment offset
+	int octant = sfc::childOctant(state, i, useHilbert);    //  Octant visited i-th by the curve
+	output[octant] = offset;                                //  Set value
+	offset += input[octant];                                //  Increment offset
       }                                                         // End loop over elements
       return output;                                            // Return output vector
     }
@@ -163,37 +148,22 @@ private:
       return (4 * n) / nspawn;                                  // Conservative estimate of number of binary tree nodes
     }
     void operator() () {                                        // Overload operator()
-      double tic = logger::get_time();
       assert(getMaxBinNode(end - begin) <= binNode->END - binNode->BEGIN);// Bounds checking for node range
-      if (begin == end) {                                       //  If no bodies are left
-	octNode = NULL;                                         //   Assign null pointer
-	return;                                                 //   End buildNodes()
-      }                                                         //  End if for no bodies
+      if (begin == end) return;                                 //  If no bodies are left end sortBodies()
       if (end - begin <= ncrit) {                               //  If number of bodies is less than threshold
 	if (direction)                                          //   If direction of data is from bodies to buffer
 	  for (int i=begin; i<end; i++) buffer[i] = bodies[i];  //    Copy bodies to buffer
-	octNode = makeOctNode(begin, end, X, true);             //   Create an octree node and assign it's pointer
-	return;                                                 //   End buildNodes()
+	return;                                                 //   End sortBodies()
       }                                                         //  End if for number of bodies
-      octNode = makeOctNode(begin, end, X, false);              //  Create an octree node with child nodes
-      double toc = logger::get_time();
-      timer["Make node"] += toc - tic;
       CountBodies countBodies(bodies, begin, end, X, binNode, nspawn);// Instantiate recursive functor
       countBodies();                                            //  Count bodies in each octant using binary recursion
-      tic = logger::get_time();
-      timer["Count bodies"] += tic - toc;
       ivec8 octantOffset = exclusiveScan(binNode->NBODY, begin);//  Exclusive scan to obtain offset from octant count
-      toc = logger::get_time();
-      timer["Exclusive scan"] += toc - tic; 
       MoveBodies moveBodies(bodies, buffer, begin, end, binNode, octantOffset, X);// Instantiate recursive functor
       moveBodies();                                             //  Sort bodies according to octant
-      tic = logger::get_time();
-      timer["Move bodies"] += tic - toc;
       BinaryTreeNode * binNodeOffset = binNode->BEGIN;          //  Initialize pointer offset for binary tree nodes
       mk_task_group;                                            //  Initialize tasks
       BinaryTreeNode binNodeChild[8];                           //  Allocate new root for this branch
       for (int i=0; i<8; i++) {                                 //  Loop over children
-	toc = logger::get_time();
 	int maxBinNode = getMaxBinNode(binNode->NBODY[i]);      //   Get maximum number of binary tree nodes
 	assert(binNodeOffset + maxBinNode <= binNode->END);     //    Bounds checking for node count
 	vec3 Xchild = X;                                        //    Initialize center coordinates of child node
@@ -203,97 +173,162 @@ private:
 	}                                                       //    End loop over dimensions
 	binNodeChild[i].BEGIN = binNodeOffset;                  //    Assign first memory address from offset
 	binNodeChild[i].END = binNodeOffset + maxBinNode;       //    Keep track of last memory address
-	tic = logger::get_time();
-	timer["Get node range"] += tic - toc;
-	BuildNodes buildNodes(octNode->CHILD[i], buffer, bodies,//    Instantiate recursive functor
+	SortBodies sortBodies(buffer, bodies,                   //    Instantiate recursive functor
 			      octantOffset[i], octantOffset[i] + binNode->NBODY[i],
-			      &binNodeChild[i], Xchild, R0, ncrit, nspawn, timer, level+1, !direction);
-	create_taskc(buildNodes);                               //    Create new task for recursive call
+			      &binNodeChild[i], Xchild, R0, ncrit, nspawn, useHilbert,
+			      level+1, sfc::childState(state, i, useHilbert), !direction);
+	create_taskc(sortBodies);                               //    Create new task for recursive call
 	binNodeOffset += maxBinNode;                            //   Increment offset for binNode memory address
       }                                                         //  End loop over children
       wait_tasks;                                               //  Synchronize tasks
-      for (int i=0; i<8; i++) {                                 //  Loop over children
-	if (octNode->CHILD[i]) octNode->NNODE += octNode->CHILD[i]->NNODE;// If child exists increment child node count
-      }                                                         //  End loop over chlidren
     }                                                           // End overload operator()
   };
 
-  //! Recursive functor for creating cell data structure from nodes
-  struct Nodes2cells {
-    OctreeNode * octNode;                                       //!< Pointer to octree node
+  //! Recursive functor for counting child cells in one level of the tree (up-sweep of a parallel prefix sum)
+  struct CountChildren {
+    Cells & cells;                                              //!< Vector of cells
     B_iter B0;                                                  //!< Iterator of first body
-    C_iter C;                                                   //!< Iterator of current cell
-    C_iter C0;                                                  //!< Iterator of first cell
-    C_iter CN;                                                  //!< Iterator of cell counter
+    ivec8 * octantCount;                                        //!< Bodies per octant of cells in this level
+    int * cellState;                                            //!< Space filling curve state of cells
+    int * rangeSum;                                             //!< Child count per range of cells (implicit binary tree)
+    int levelBegin;                                             //!< Index of first cell in this level
+    int begin;                                                  //!< Cell begin index
+    int end;                                                    //!< Cell end index
+    int node;                                                   //!< Index of range in binary tree
+    int ncrit;                                                  //!< Number of bodies per leaf cell
+    int nspawn;                                                 //!< Threshold of NBODY for spawning new threads
+    int useHilbert;                                             //!< Order children along Hilbert curve
+    CountChildren(Cells & _cells, B_iter _B0, ivec8 * _octantCount, int * _cellState, int * _rangeSum,// Constructor
+		  int _levelBegin, int _begin, int _end, int _node, int _ncrit, int _nspawn, int _useHilbert) :
+      cells(_cells), B0(_B0), octantCount(_octantCount), cellState(_cellState), rangeSum(_rangeSum),// Initialize variables
+      levelBegin(_levelBegin), begin(_begin), end(_end), node(_node), ncrit(_ncrit), nspawn(_nspawn),
+      useHilbert(_useHilbert) {}
+    //! Position of the octant of a body among the children of cell C
+    inline int childIndex(B_iter B, C_iter C, int state) const {
+      int octant = (B->X[0] > C->X[0]) + ((B->X[1] > C->X[1]) << 1) + ((B->X[2] > C->X[2]) << 2);// Octant of body
+      return sfc::childIndex(state, octant, useHilbert);        // Position of octant in curve order
+    }
+    void operator() () {                                        // Overload operator()
+      int nbody = cells[end-1].IBODY + cells[end-1].NBODY - cells[begin].IBODY;// Bodies in range of cells
+      if (end - begin == 1 || nbody <= nspawn) {                //  If range is small enough
+	int nchild = 0;                                         //   Initialize child counter of range
+	for (int c=begin; c<end; c++) {                         //   Loop over cells
+	  C_iter C = cells.begin() + c;                         //    Cell iterator
+	  ivec8 & count = octantCount[c-levelBegin];            //    Bodies per octant of cell
+	  count = 0;                                            //    Initialize bodies per octant
+	  C->ICHILD = nchild;                                   //    Offset of children within range
+	  C->NCHILD = 0;                                        //    Initialize number of child cells
+	  if (C->NBODY > ncrit) {                               //    If cell is split
+	    int ibody = C->IBODY;                               //     Begin of body range for current octant
+	    for (int i=0; i<8; i++) {                           //     Loop over octants in curve order
+	      int lo = ibody, hi = C->IBODY + C->NBODY;         //      Bodies are sorted by octant position
+	      while (lo < hi) {                                 //      Binary search for end of octant
+		int mid = (lo + hi) / 2;                        //       Middle of search range
+		if (childIndex(B0+mid, C, cellState[c]) <= i) lo = mid + 1;// Body is in this or an earlier octant
+		else hi = mid;                                  //       Body is in a later octant
+	      }                                                 //      End while for binary search
+	      int octant = sfc::childOctant(cellState[c], i, useHilbert);// Octant visited i-th by the curve
+	      count[octant] = lo - ibody;                       //      Number of bodies in octant
+	      C->NCHILD += count[octant] > 0;                   //      Count non-empty octants
+	      ibody = lo;                                       //      Next octant starts here
+	    }                                                   //     End loop over octants
+	  }                                                     //    End if for split cell
+	  nchild += C->NCHILD;                                  //    Accumulate child count
+	}                                                       //   End loop over cells
+	rangeSum[node] = nchild;                                //   Store child count of range
+      } else {                                                  //  Else if range is large
+	int mid = (begin + end) / 2;                            //   Split range of cells in half
+	mk_task_group;                                          //   Initialize tasks
+	CountChildren leftBranch(cells, B0, octantCount, cellState, rangeSum, levelBegin, begin, mid,
+				 2*node+1, ncrit, nspawn, useHilbert);
+	create_taskc(leftBranch);                               //   Create new task for left branch
+	CountChildren rightBranch(cells, B0, octantCount, cellState, rangeSum, levelBegin, mid, end,
+				  2*node+2, ncrit, nspawn, useHilbert);
+	rightBranch();                                          //   Use old task for right branch
+	wait_tasks;                                             //   Synchronize tasks
+	rangeSum[node] = rangeSum[2*node+1] + rangeSum[2*node+2];// Sum contribution from both branches
+      }                                                         //  End if for size of range
+    }                                                           // End overload operator()
+  };
+
+  //! Recursive functor for creating child cells of one level of the tree (down-sweep of a parallel prefix sum)
+  struct LinkChildren {
+    Cells & cells;                                              //!< Vector of cells
+    B_iter B0;                                                  //!< Iterator of first body
+    ivec8 * octantCount;                                        //!< Bodies per octant of cells in this level
+    int * cellState;                                            //!< Space filling curve state of cells
+    int * rangeSum;                                             //!< Child count per range of cells (implicit binary tree)
+    int levelBegin;                                             //!< Index of first cell in this level
+    int begin;                                                  //!< Cell begin index
+    int end;                                                    //!< Cell end index
+    int node;                                                   //!< Index of range in binary tree
+    int offset;                                                 //!< Index of first child cell of range
     vec3 X0;                                                    //!< Coordinate of root cell center
     real_t R0;                                                  //!< Radius of root cell
-    int nspawn;                                                 //!< Threshold of NNODE for spawning new threads
-    int & maxlevel;                                             //!< Maximum tree level
-    int level;                                                  //!< Current tree level
-    int iparent;                                                //!< Index of parent cell
-    Nodes2cells(OctreeNode * _octNode, B_iter _B0, C_iter _C,   // Constructor
-		C_iter _C0, C_iter _CN, vec3 _X0, real_t _R0,
-		int _nspawn, int & _maxlevel, int _level=0, int _iparent=0) :
-      octNode(_octNode), B0(_B0), C(_C), C0(_C0), CN(_CN),      // Initialize variables
-      X0(_X0), R0(_R0), nspawn(_nspawn), maxlevel(_maxlevel), level(_level), iparent(_iparent) {}
-    //! Get cell index
-    uint64_t getKey(vec3 X, vec3 Xmin, real_t diameter, int level) {
-      int iX[3] = {0, 0, 0};                                    // Initialize 3-D index
-      for (int d=0; d<3; d++) iX[d] = int((X[d] - Xmin[d]) / diameter);// 3-D index
-      uint64_t index = ((1 << 3 * level) - 1) / 7;              // Levelwise offset
-      for (int l=0; l<level; l++) {                             // Loop over levels
-	for (int d=0; d<3; d++) index += (iX[d] & 1) << (3 * l + d); // Interleave bits into Morton key
-	for (int d=0; d<3; d++) iX[d] >>= 1;                    //  Bitshift 3-D index
-      }                                                         // End loop over levels
-      return index;                                             // Return Morton key
-    }
+    int level;                                                  //!< Tree level of the parent cells
+    int nspawn;                                                 //!< Threshold of NBODY for spawning new threads
+    int useHilbert;                                             //!< Order children along Hilbert curve
+    LinkChildren(Cells & _cells, B_iter _B0, ivec8 * _octantCount, int * _cellState,// Constructor
+		 int * _rangeSum, int _levelBegin, int _begin, int _end, int _node, int _offset,
+		 vec3 _X0, real_t _R0, int _level, int _nspawn, int _useHilbert) :
+      cells(_cells), B0(_B0), octantCount(_octantCount), cellState(_cellState),// Initialize variables
+      rangeSum(_rangeSum), levelBegin(_levelBegin), begin(_begin), end(_end), node(_node), offset(_offset),
+      X0(_X0), R0(_R0), level(_level), nspawn(_nspawn), useHilbert(_useHilbert) {}
     void operator() () {                                        // Overload operator()
-      C->IPARENT = iparent;                                     //  Index of parent cell
-      C->R       = R0 / (1 << level);                           //  Cell radius
-      C->X       = octNode->X;                                  //  Cell center
-      C->NBODY   = octNode->NBODY;                              //  Number of decendant bodies
-      C->IBODY   = octNode->IBODY;                              //  Index of first body in cell
-      C->BODY    = B0 + C->IBODY;                               //  Iterator of first body in cell
-      C->ICELL   = getKey(C->X, X0-R0, 2*C->R, level);          //  Get Morton key
-      if (octNode->NNODE == 1) {                                //  If node has no children
-	C->ICHILD = 0;                                          //   Set index of first child cell to zero
-	C->NCHILD = 0;                                          //   Number of child cells
-	assert(C->NBODY > 0);                                   //   Check for empty leaf cells
-	maxlevel = std::max(maxlevel, level);                   //   Update maximum level of tree
-      } else {                                                  //  Else if node has children
-	int nchild = 0;                                         //   Initialize number of child cells
-	int octants[8];                                         //   Map of child index to octants
-	for (int i=0; i<8; i++) {                               //   Loop over octants
-	  if (octNode->CHILD[i]) {                              //    If child exists for that octant
-	    octants[nchild] = i;                                //     Map octant to child index
-	    nchild++;                                           //     Increment child cell counter
-	  }                                                     //    End if for child existance
-	}                                                       //   End loop over octants
-	C_iter Ci = CN;                                         //   CN points to the next free memory address
-	C->ICHILD = Ci - C0;                                    //   Set Index of first child cell
-	C->NCHILD = nchild;                                     //   Number of child cells
-	assert(C->NCHILD > 0);                                  //   Check for childless non-leaf cells
-	CN += nchild;                                           //   Increment next free memory address
+      int nbody = cells[end-1].IBODY + cells[end-1].NBODY - cells[begin].IBODY;// Bodies in range of cells
+      if (end - begin == 1 || nbody <= nspawn) {                //  If range is small enough
+	real_t r = R0 / (1 << (level + 1));                     //   Radius of cells for child's level
+	for (int c=begin; c<end; c++) {                         //   Loop over cells
+	  C_iter C = cells.begin() + c;                         //    Cell iterator
+	  if (C->NCHILD == 0) {                                 //    If cell is a leaf
+	    C->ICHILD = 0;                                      //     Set index of first child cell to zero
+	    continue;                                           //     Skip to next cell
+	  }                                                     //    End if for leaf cell
+	  C->ICHILD += offset;                                  //    Index of first child cell
+	  C_iter Ci = cells.begin() + C->ICHILD;                //    Iterator of first child cell
+	  int ibody = C->IBODY;                                 //    Index of first body in child cell
+	  ivec8 & count = octantCount[c-levelBegin];            //    Bodies per octant of cell
+	  for (int i=0; i<8; i++) {                             //    Loop over octants in curve order
+	    int octant = sfc::childOctant(cellState[c], i, useHilbert);// Octant visited i-th by the curve
+	    if (count[octant] == 0) continue;                   //     Skip empty octants
+	    Ci->X = C->X;                                       //     Initialize center coordinates of child cell
+	    for (int d=0; d<3; d++) {                           //     Loop over dimensions
+	      Ci->X[d] += r * (((octant & 1 << d) >> d) * 2 - 1);//     Shift center coordinates to that of child cell
+	    }                                                   //     End loop over dimensions
+	    Ci->R       = r;                                    //     Cell radius
+	    Ci->IPARENT = c;                                    //     Index of parent cell
+	    Ci->IBODY   = ibody;                                //     Index of first body in cell
+	    Ci->NBODY   = count[octant];                        //     Number of descendant bodies
+	    Ci->BODY    = B0 + ibody;                           //     Iterator of first body in cell
+	    Ci->ICELL   = getKey(Ci->X, X0-R0, 2*r, level+1, useHilbert);// Get Morton or Hilbert key
+	    cellState[Ci-cells.begin()] = sfc::childState(cellState[c], octant, useHilbert);// Curve state of child
+	    ibody += count[octant];                             //     Increment body index
+	    Ci++;                                               //     Increment child cell iterator
+	  }                                                     //    End loop over octants
+	}                                                       //   End loop over cells
+      } else {                                                  //  Else if range is large
+	int mid = (begin + end) / 2;                            //   Split range of cells in half
 	mk_task_group;                                          //   Initialize tasks
-	for (int i=0; i<nchild; i++) {                          //   Loop over children
-	  int octant = octants[i];                              //    Get octant from child index
-          Nodes2cells nodes2cells(octNode->CHILD[octant],       //    Instantiate recursive functor
-				  B0, Ci, C0, CN, X0, R0, nspawn, maxlevel, level+1, C-C0);
-	  create_taskc_if(octNode->NNODE > nspawn,              //    Spawn task if number of sub-nodes is large
-			  nodes2cells);                         //    Recursive call for each child
-	  Ci++;                                                 //    Increment cell iterator
-	  CN += octNode->CHILD[octant]->NNODE - 1;              //    Increment next free memory address
-	}                                                       //   End loop over children
+	LinkChildren leftBranch(cells, B0, octantCount, cellState, rangeSum, levelBegin, begin, mid,
+				2*node+1, offset, X0, R0, level, nspawn, useHilbert);
+	create_taskc(leftBranch);                               //   Create new task for left branch
+	LinkChildren rightBranch(cells, B0, octantCount, cellState, rangeSum, levelBegin, mid, end,
+				 2*node+2, offset+rangeSum[2*node+1], X0, R0, level, nspawn, useHilbert);
+	rightBranch();                                          //   Use old task for right branch
 	wait_tasks;                                             //   Synchronize tasks
-	for (int i=0; i<nchild; i++) {                          //   Loop over children
-	  int octant = octants[i];                              //    Get octant from child index
-	  delete octNode->CHILD[octant];                        //    Free child pointer to avoid memory leak
-	}                                                       //   End loop over children
-	maxlevel = std::max(maxlevel, level+1);                 //   Update maximum level of tree
-      }                                                         //  End if for child existance
+      }                                                         //  End if for size of range
     }                                                           // End overload operator()
   };
 
+  //! Get cell index
+  static uint64_t getKey(vec3 X, vec3 Xmin, real_t diameter, int level, int useHilbert) {
+    int iX[3] = {0, 0, 0};                                      // Initialize 3-D index
+    for (int d=0; d<3; d++) iX[d] = int((X[d] - Xmin[d]) / diameter);// 3-D index
+    uint64_t index = ((1 << 3 * level) - 1) / 7;                // Levelwise offset
+    index += sfc::getKey(iX[0], iX[1], iX[2], level, useHilbert);// Add Morton or Hilbert key
+    return index;                                               // Return cell index
+  }
+
   //! Transform Xmin & Xmax to X (center) & R (radius)
   Box bounds2box(Bounds bounds) {
     vec3 Xmin = bounds.Xmin;                                    // Set local Xmin
@@ -313,64 +348,70 @@ private:
   void growTree(Bodies & bodies, Bodies & buffer, Box box) {
     assert(box.R > 0);                                          // Check for bounds validity
     logger::startTimer("Grow tree");                            // Start timer
-    B0 = bodies.begin();                                        // Bodies iterator
     BinaryTreeNode binNode[1];                                  // Allocate root node of binary tree
     int maxBinNode = (4 * bodies.size()) / nspawn;              // Get maximum size of binary tree
-    binNode->BEGIN = new BinaryTreeNode[maxBinNode];            // Allocate array for binary tree nodes
+    if (int(binNodePool.size()) < maxBinNode + 1) binNodePool.resize(maxBinNode + 1);// Grow binary tree storage
+    binNode->BEGIN = &binNodePool[0];                           // Set begin pointer to binary tree storage
     binNode->END = binNode->BEGIN + maxBinNode;                 // Set end pointer
-    logger::Timer timer;
-    BuildNodes buildNodes(N0, bodies, buffer, 0, bodies.size(),
-			  binNode, box.X, box.R, ncrit, nspawn, timer);// Instantiate recursive functor
-    buildNodes();                                               // Recursively build octree nodes
-    delete[] binNode->BEGIN;                                    // Deallocate binary tree array
-#if 0
-    logger::printTitle("Grow tree");
-    std::cout << std::setw(logger::stringLength) << std::left
-	      << "Make node" << " : " << timer["Make node"] << " s\n"
-	      << std::setw(logger::stringLength) << std::left
-	      << "Count bodies" << " : " << timer["Count bodies"] << " s\n"
-	      << std::setw(logger::stringLength) << std::left
-	      << "Exclusive scan" << " : " << timer["Exclusive scan"] << " s\n"
-	      << std::setw(logger::stringLength) << std::left
-	      << "Move bodies" << " : " << timer["Move bodies"] << " s\n"
-	      << std::setw(logger::stringLength) << std::left
-	      << "Get node range" << " : " << timer["Get node range"] << " s\n"
-	      << std::setw(logger::stringLength) << std::left
-	      << "Total grow tree" << " : " << timer["Make node"] +
-      timer["Count bodies"] + timer["Exclusive scan"] +
-      timer["Move bodies"] + timer["Get node range"] << " s" << std::endl;
-#endif
+    SortBodies sortBodies(bodies, buffer, 0, bodies.size(),
+			  binNode, box.X, box.R, ncrit, nspawn, useHilbert);// Instantiate recursive functor
+    sortBodies();                                               // Recursively sort bodies into octants
     logger::stopTimer("Grow tree");                             // Stop timer
   }
 
-  //! Link tree structure
-  Cells linkTree(Box box) {
+  //! Link tree structure level by level directly from the sorted bodies
+  Cells linkTree(Bodies & bodies, Box box) {
     logger::startTimer("Link tree");                            // Start timer
     Cells cells;                                                // Initialize cell array
-    if (N0 != NULL) {                                           // If the node tree is not empty
-      cells.resize(N0->NNODE);                                  //  Allocate cells array
-      C_iter C0 = cells.begin();                                //  Cell begin iterator
-      Nodes2cells nodes2cells(N0, B0, C0, C0, C0+1, box.X, box.R, nspawn, maxlevel);// Instantiate recursive functor
-      nodes2cells();                                            //  Convert nodes to cells recursively
-      delete N0;                                                //  Deallocate nodes
-    }                                                           // End if for empty node tree
+    maxlevel = 0;                                               // Initialize maximum level of tree
+    if (!bodies.empty()) {                                      // If the tree is not empty
+      B_iter B0 = bodies.begin();                               //  Iterator of first body
+      cells.resize(1);                                          //  Allocate root cell
+      C_iter C = cells.begin();                                 //  Root cell iterator
+      C->IPARENT = 0;                                           //  Index of parent cell
+      C->R       = box.R;                                       //  Cell radius
+      C->X       = box.X;                                       //  Cell center
+      C->NBODY   = bodies.size();                               //  Number of decendant bodies
+      C->IBODY   = 0;                                           //  Index of first body in cell
+      C->BODY    = B0;                                          //  Iterator of first body in cell
+      C->ICELL   = 0;                                           //  Cell index of root
+      if (cellState.empty()) cellState.resize(1);               //  Allocate curve state of root
+      cellState[0] = 0;                                         //  Curve state of root
+      int begin = 0, end = 1;                                   //  Range of cells in current level
+      for (int level=0; begin<end; level++) {                   //  Loop over levels
+	int numCells = end - begin;                             //   Number of cells in current level
+	if (int(octantCount.size()) < numCells) octantCount.resize(numCells);// Grow octant count storage
+	if (int(rangeSum.size()) < 4 * numCells) rangeSum.resize(4 * numCells);// Grow range sum storage
+	CountChildren countChildren(cells, B0, &octantCount[0], &cellState[0], &rangeSum[0],
+				    begin, begin, end, 0, ncrit, nspawn, useHilbert);// Instantiate recursive functor
+	countChildren();                                        //   Count child cells (up-sweep)
+	int numChild = rangeSum[0];                             //   Number of cells in next level
+	cells.resize(end + numChild);                           //   Allocate cells of next level
+	if (cellState.size() < cells.size()) cellState.resize(cells.size());// Grow curve state storage
+	LinkChildren linkChildren(cells, B0, &octantCount[0], &cellState[0], &rangeSum[0],
+				  begin, begin, end, 0, end, box.X, box.R, level, nspawn, useHilbert);
+	linkChildren();                                         //   Create child cells (down-sweep)
+	if (numChild > 0) maxlevel = level + 1;                 //   Update maximum level of tree
+	begin = end;                                            //   Next level starts after current level
+	end = cells.size();                                     //   Next level ends at the last cell
+      }                                                         //  End loop over levels
+    }                                                           // End if for empty tree
     logger::stopTimer("Link tree");                             // Stop timer
     return cells;                                               // Return cells array
   }
 
 public:
-  BuildTree(int _ncrit, int _nspawn) : ncrit(_ncrit), nspawn(_nspawn), maxlevel(0) {}
+  BuildTree(int _ncrit, int _nspawn, int _useHilbert=0) :
+    ncrit(_ncrit), nspawn(_nspawn), useHilbert(_useHilbert), maxlevel(0) {}
 
   //! Build tree structure top down
   Cells buildTree(Bodies & bodies, Bodies & buffer, Bounds bounds) {
     Box box = bounds2box(bounds);                               // Get box from bounds
-    if (bodies.empty()) {                                       // If bodies vector is empty
-      N0 = NULL;                                                //  Reinitialize N0 with NULL
-    } else {                                                    // If bodies vector is not empty
+    if (!bodies.empty()) {                                      // If bodies vector is not empty
       if (bodies.size() > buffer.size()) buffer.resize(bodies.size());// Enlarge buffer if necessary
-      growTree(bodies, buffer, box);                            //  Grow tree from root
+      growTree(bodies, buffer, box);                            //  Sort bodies top down
     }                                                           // End if for empty root
-    return linkTree(box);                                       // Form parent-child links in tree
+    return linkTree(bodies, box);                               // Form cells and parent-child links in tree
   }
 
   //! Print tree structure statistics
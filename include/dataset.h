@@ -266,7 +266,7 @@ public:
 
   //! Downsize target bodies by even sampling
   void sampleBodies(Bodies & bodies, int numTargets) {
-    if (numTargets < int(bodies.size())) {                      // If target size is smaller than current
+    if (0 < numTargets && numTargets < int(bodies.size())) {    // If target size is smaller than current (0 keeps all)
       int stride = bodies.size() / numTargets;                  //  Stride of sampling
       for (int i=0; i<numTargets; i++) {                        //  Loop over target samples
         bodies[i] = bodies[i*stride];                           //   Sample targets
@@ -129,6 +129,53 @@ private:
     }                                                           // End overload operator()
   };
 
+  //! Recursive functor for the Ewald real part of a range of target bodies by minimum image summation
+  struct MinimumImage {
+    const Ewald * ewald;                                        //!< Ewald object
+    B_iter Bi;                                                  //!< Iterator of first target body
+    int ni;                                                     //!< Number of target bodies
+    B_iter Bj;                                                  //!< Iterator of first source body
+    int nj;                                                     //!< Number of source bodies
+    MinimumImage(const Ewald * _ewald, B_iter _Bi, int _ni, B_iter _Bj, int _nj) :// Constructor
+      ewald(_ewald), Bi(_Bi), ni(_ni), Bj(_Bj), nj(_nj) {}      // Initialize variables
+    void operator() () {                                        // Overload operator()
+      if (ni <= 64) {                                           //  If target range is small enough
+	const real_t alpha = ewald->alpha;                      //   Scaling parameter
+	const real_t cutoff2 = ewald->cutoff * ewald->cutoff;   //   Cutoff squared
+	for (B_iter B=Bi; B!=Bi+ni; B++) {                      //   Loop over target bodies
+	  kvec4 TRG = kreal_t(0);                               //    Initialize target values
+	  for (B_iter BB=Bj; BB!=Bj+nj; BB++) {                 //    Loop over source bodies
+	    vec3 dX = B->X - BB->X;                             //     Distance vector from source to target
+	    wrap(dX, ewald->cycle);                             //     Nearest periodic image of the source
+	    real_t R2 = norm(dX);                               //     R^2
+	    if (R2 == 0) {                                      //     If source is the target itself
+	      TRG[0] -= M_2_SQRTPI * BB->SRC * alpha;           //      Self term of Ewald real part
+	    } else if (R2 < cutoff2) {                          //     Else if source is within cutoff
+	      real_t R2s = R2 * alpha * alpha;                  //      (R * alpha)^2
+	      real_t Rs = std::sqrt(R2s);                       //      R * alpha
+	      real_t invRs = 1 / Rs;                            //      1 / (R * alpha)
+	      real_t invR2s = invRs * invRs;                    //      1 / (R * alpha)^2
+	      real_t invR3s = invR2s * invRs;                   //      1 / (R * alpha)^3
+	      real_t dtmp = BB->SRC * (M_2_SQRTPI * exp(-R2s) * invR2s + erfc(Rs) * invR3s);
+	      dtmp *= alpha * alpha * alpha;                    //      Scale temporary value
+	      TRG[0] += BB->SRC * erfc(Rs) * invRs * alpha;     //      Ewald real potential
+	      for (int d=0; d<3; d++) TRG[d+1] -= dX[d] * dtmp; //      Ewald real force
+	    }                                                   //     End if for self interaction
+	  }                                                     //    End loop over source bodies
+	  B->TRG += TRG;                                        //    Accumulate target values
+	}                                                       //   End loop over target bodies
+      } else {                                                  //  If target range is large
+	int nhalf = ni / 2;                                     //   Number of targets in first half
+	mk_task_group;                                          //   Initialize task group
+	MinimumImage leftBranch(ewald, Bi, nhalf, Bj, nj);      //   Instantiate recursive functor
+	create_taskc(leftBranch);                               //   Create new task for left branch
+	MinimumImage rightBranch(ewald, Bi+nhalf, ni-nhalf, Bj, nj);// Instantiate recursive functor
+	rightBranch();                                          //   Use old task for right branch
+	wait_tasks;                                             //   Synchronize task group
+      }                                                         //  End if for small range
+    }                                                           // End overload operator()
+  };
+
 public:
   //! Constructor
   Ewald(int _ksize, real_t _alpha, real_t _sigma, real_t _cutoff, real_t _cycle) :
@@ -149,6 +196,14 @@ public:
     logger::stopTimer("Ewald real part");                       // Stop timer
   }
 
+  //! Ewald real part by summing the nearest periodic image of every source (cutoff must not exceed cycle / 2)
+  void realPart(Bodies & bodies, Bodies & jbodies) const {
+    logger::startTimer("Ewald real part");                      // Start timer
+    MinimumImage minimumImage(this, bodies.begin(), bodies.size(), jbodies.begin(), jbodies.size());// Instantiate functor
+    minimumImage();                                             // Sum nearest images including the self term
+    logger::stopTimer("Ewald real part");                       // Stop timer
+  }
+
   //! Subtract self term
   void selfTerm(Bodies & bodies) {
     for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {       //  Loop over all bodies
@@ -1,11 +1,30 @@
 #ifndef kahan_h
 #define kahan_h
+#include <cstring>
 #include <iostream>
 #ifndef __CUDACC__
 #define __host__
 #define __device__
 #define __forceinline__
 #endif
+
+//! Hide a value from the optimizer so that -ffast-math can not fold the compensation away
+template<typename T>
+__host__ __device__ __forceinline__
+void opaque(T & v) {
+#if defined(__GNUC__) && defined(__SSE__) && !defined(__CUDA_ARCH__)
+  typedef float raw_t __attribute__ ((vector_size (sizeof(T))));// Raw SIMD register of the same size
+  raw_t r;                                                      // Register copy of v
+  std::memcpy(&r, &v, sizeof(T));                               // Copy v to register
+  asm("" : "+x"(r));                                            // Empty asm that may modify r
+  std::memcpy((void*)&v, &r, sizeof(T));                        // Copy back to v
+#endif
+}
+#if defined(__GNUC__) && defined(__SSE__) && !defined(__CUDA_ARCH__)
+inline void opaque(float & v) { asm("" : "+x"(v)); }            // Scalar single precision
+inline void opaque(double & v) { asm("" : "+x"(v)); }           // Scalar double precision
+#endif
+
 //! Operator overloading for Kahan summation
 template<typename T>
 struct kahan {
@@ -32,19 +51,23 @@ struct kahan {
     return *this;
   }
   __host__ __device__ __forceinline__
+  void add(const T v) {                                         // Compensated addition (value is s + c)
+    T y = v + c;                                                // Add low order part lost so far
+    T t = s + y;                                                // High order part of the sum
+    opaque(t);                                                  // Keep t - s from being folded into y
+    T d = t - s;                                                // Part of y that made it into t
+    opaque(d);                                                  // Keep y - d from being reassociated
+    c = y - d;                                                  // Low order part of y that was lost
+    s = t;                                                      // Update high order part
+  }
+  __host__ __device__ __forceinline__
   const kahan &operator+=(const T v) {                          // Scalar compound assignment (add)
-    T y = v - c;
-    T t = s + y;
-    c = (t - s) - y;
-    s = t;
+    add(v);
     return *this;
   }
   __host__ __device__ __forceinline__
   const kahan &operator-=(const T v) {                          // Scalar compound assignment (subtract)
-    T y = - v - c;
-    T t = s + y;
-    c = (t - s) - y;
-    s = t; 
+    add(-v);
     return *this;
   }
   __host__ __device__ __forceinline__
@@ -67,26 +90,14 @@ struct kahan {
   }
   __host__ __device__ __forceinline__
   const kahan &operator+=(const kahan & v) {                    // Vector compound assignment (add)
-    T y = v.s - c;
-    T t = s + y;
-    c = (t - s) - y;
-    s = t;
-    y = v.c - c;
-    t = s + y;
-    c = (t - s) - y;
-    s = t;
+    add(v.s);
+    add(v.c);
     return *this;
   }
   __host__ __device__ __forceinline__
   const kahan &operator-=(const kahan & v) {                    // Vector compound assignment (subtract)
-    T y = - v.s - c;
-    T t = s + y;
-    c = (t - s) - y;
-    s = t;
-    y = - v.c - c;
-    t = s + y;
-    c = (t - s) - y;
-    s = t;
+    add(-v.s);
+    add(-v.c);
     return *this;
   }
   __host__ __device__ __forceinline__
@@ -4,11 +4,20 @@
 #include "types.h"
 
 namespace kernel {
+  typedef void (*P2PKernel)(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic);//!< P2P kernel specialized on eps2, Xperiodic and mutual
+  P2PKernel P2PVariant(bool soft, bool periodic, bool mutual);  //!< P2P kernel for eps2!=0, Xperiodic!=0 and mutual as given
   void P2P(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic, bool mutual); //!< P2P kernel between cells Ci and Cj
   void P2P(C_iter C, real_t eps2);                              //!< P2P kernel for cell C
   void P2M(C_iter C);                                           //!< P2M kernel for cell C
   void M2M(C_iter Ci, C_iter C0);                               //!< M2M kernel for one parent cell Ci
   void M2L(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual);  //!< M2L kernel between cells Ci and Cj
+  void M2L(C_iter Ci, const C_iter * Cj, const vec3 * Xperiodic, int numCj);//!< M2L kernel from a list of cells Cj to Ci
+  void M2P(C_iter Ci, C_iter Cj, vec3 Xperiodic);               //!< M2P kernel from cell Cj to the bodies of Ci
+  void P2L(C_iter Ci, C_iter Cj, vec3 Xperiodic);               //!< P2L kernel from the bodies of Cj to cell Ci
+  double P2POps();                                              //!< Op-count model of P2P per body pair
+  double M2LOps(bool mutual);                                   //!< Op-count model of one M2L (or mutual M2L) call
+  double M2POps(int numBodies);                                 //!< Op-count model of M2P to numBodies target bodies
+  double P2LOps(int numBodies);                                 //!< Op-count model of P2L from numBodies source bodies
   void L2L(C_iter Ci, C_iter C0);                               //!< L2L kernel for one child cell Ci
   void L2P(C_iter Ci);                                          //!< L2P kernel for cell Ci
 };
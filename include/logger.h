@@ -162,11 +162,42 @@ namespace logger {
 #if PAPI
     if (!PAPIEventCodes.empty()) {                              // If PAPI events are set
       PAPIEventValues.resize(PAPIEventCodes.size());            //  Resize PAPI event value vector
-      PAPI_stop(PAPIEventSet, &PAPIEventValues[0]);             //  Stop PAPI counter
+      PAPI_stop(PAPIEventSet, reinterpret_cast<long long*>(&PAPIEventValues[0]));// Stop PAPI counter
     }                                                           // End if for PAPI events
 #endif
   }
 
+  //! Read PAPI counters without stopping them (empty if no events are set)
+  inline void readPAPI(std::vector<uint64_t> & values) {
+    values.clear();                                             // No counters by default
+#if PAPI
+    if (!PAPIEventCodes.empty()) {                              // If PAPI events are set
+      values.resize(PAPIEventCodes.size());                     //  Resize value vector
+      PAPI_read(PAPIEventSet, reinterpret_cast<long long*>(&values[0]));// Read PAPI counters
+    }                                                           // End if for PAPI events
+#endif
+  }
+
+#if PAPI
+  //! Print miss rates for PAPI miss events (*_TCM, *_DCM) whose access event (*_TCA, *_DCA) is also set
+  inline void printMissRates(const std::vector<uint64_t> & values) {
+    for (int i=0; i<int(values.size()); i++) {                  // Loop over PAPI events
+      std::string miss = PAPIEventNames[i];                     //  Name of miss event
+      int n = miss.size();                                      //  Length of name
+      if (n < 2 || miss.compare(n-2, 2, "CM") != 0) continue;   //  Skip events that are not misses
+      std::string access = miss.substr(0, n-2) + "CA";          //  Name of access event
+      for (int j=0; j<int(values.size()); j++) {                //  Loop over PAPI events
+        if (access != PAPIEventNames[j] || values[j] == 0) continue;// Skip other events
+        std::cout << std::setw(stringLength) << std::left       //   Set format
+		  << miss + " rate" << " : " << std::setprecision(decimal) << std::fixed
+		  << double(values[i]) / values[j] << std::endl; //   Print miss rate
+      }                                                         //  End loop over PAPI events
+    }                                                           // End loop over PAPI events
+  }
+#else
+  inline void printMissRates(const std::vector<uint64_t> &) {}
+#endif
+
   //! Print PAPI event
   inline void printPAPI() {
 #if PAPI
@@ -177,6 +208,7 @@ namespace logger {
 		  << PAPIEventNames[i] << " : " << std::setprecision(decimal) << std::fixed
 		  << PAPIEventValues[i] << std::endl;           //   Print event and timer
       }                                                         //  End loop over PAPI events
+      printMissRates(PAPIEventValues);                          //  Print miss rates
     }                                                           // End if for PAPI events
 #endif
   }
@@ -14,8 +14,8 @@
 #endif
 
 // Detect SIMD Byte length of architecture
-#if __MIC__
-const int SIMD_BYTES = 64;                                      //!< SIMD byte length of MIC
+#if __MIC__ | __AVX512F__
+const int SIMD_BYTES = 64;                                      //!< SIMD byte length of MIC and AVX-512
 #elif __AVX__ | __bgq__
 const int SIMD_BYTES = 32;                                      //!< SIMD byte length of AVX and BG/Q
 #elif __SSE__ | __bgp__ | __sparc_v9__
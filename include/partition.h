@@ -1,6 +1,8 @@
 #ifndef partition_h
 #define partition_h
+#include <algorithm>
 #include "logger.h"
+#include "sfc.h"
 #include "sort.h"
 
 //! Handles all the partitioning of domains
@@ -233,6 +235,79 @@ public:
     return local;
   }
 
+  //! Partition bodies into segments of equal weight along a space filling curve
+  Bounds sfcsection(Bodies & bodies, Bounds global, bool useHilbert) {
+    logger::startTimer("Partition");                            // Start timer
+    const int level = 10;                                       // Level of keys used for splitting
+    const int numBodies = bodies.size();                        // Number of local bodies
+    vec3 X0 = (global.Xmax + global.Xmin) / 2;                  // Center of global domain
+    real_t R0 = max(global.Xmax - X0) * 1.00001;                // Radius of global domain
+    real_t diameter = 2 * R0 / (1 << level);                    // Cell size at key level
+    std::vector<std::pair<uint64_t,int> > keys(numBodies);      // Keys and indices of bodies
+    for (int b=0; b<numBodies; b++) {                           // Loop over bodies
+      int iX[3];                                                //  3-D index
+      for (int d=0; d<3; d++) {                                 //  Loop over dimensions
+	iX[d] = int((bodies[b].X[d] - X0[d] + R0) / diameter);  //   Index in this dimension
+	iX[d] = std::min(std::max(iX[d], 0), (1 << level) - 1); //   Clamp to global domain
+      }                                                         //  End loop over dimensions
+      keys[b].first = sfc::getKey(iX[0], iX[1], iX[2], level, useHilbert);// Morton or Hilbert key
+      keys[b].second = b;                                       //  Index of body
+    }                                                           // End loop over bodies
+    std::sort(keys.begin(), keys.end());                        // Sort bodies by key
+    std::vector<float> weightScan(numBodies+1, 0);              // Inclusive scan of weights in key order
+    for (int b=0; b<numBodies; b++) {                           // Loop over sorted bodies
+      weightScan[b+1] = weightScan[b] + bodies[keys[b].second].WEIGHT;// Accumulate weight
+    }                                                           // End loop over sorted bodies
+    float globalWeightSum;                                      // Global sum of weights
+    MPI_Allreduce(&weightScan[numBodies], &globalWeightSum, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);// Reduce sum of weights
+    std::vector<uint64_t> keyBegin(mpisize, 0);                 // Lower bound of splitter key per rank
+    std::vector<uint64_t> keyEnd(mpisize, uint64_t(1) << 3 * level);// Upper bound of splitter key per rank
+    std::vector<float> localWeight(mpisize), globalWeight(mpisize);// Weight below splitter key per rank
+    for (int iter=0; iter<=3*level; iter++) {                   // Bisect splitter keys bit by bit
+      for (int irank=0; irank<mpisize; irank++) {               //  Loop over MPI ranks
+	uint64_t keyMid = (keyBegin[irank] + keyEnd[irank]) / 2;//   Trial splitter key
+	int b = std::lower_bound(keys.begin(), keys.end(), std::make_pair(keyMid, 0)) - keys.begin();// Bodies below
+	localWeight[irank] = weightScan[b];                     //   Local weight below trial splitter
+      }                                                         //  End loop over MPI ranks
+      MPI_Allreduce(&localWeight[0], &globalWeight[0], mpisize, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);// Reduce weights
+      for (int irank=0; irank<mpisize; irank++) {               //  Loop over MPI ranks
+	uint64_t keyMid = (keyBegin[irank] + keyEnd[irank]) / 2;//   Trial splitter key
+	if (globalWeight[irank] >= globalWeightSum * irank / mpisize) keyEnd[irank] = keyMid;// Splitter is below
+	else keyBegin[irank] = keyMid + 1;                      //   Splitter is above
+      }                                                         //  End loop over MPI ranks
+    }                                                           // End loop for bisection
+    keyBegin[0] = 0;                                            // First rank starts at the beginning of the curve
+    std::vector<float> localXmin(3*mpisize), localXmax(3*mpisize);// Bounds of bodies per rank
+    for (int i=0; i<3*mpisize; i++) {                           // Loop over bounds
+      localXmin[i] = global.Xmax[i%3];                          //  Initialize Xmin
+      localXmax[i] = global.Xmin[i%3];                          //  Initialize Xmax
+    }                                                           // End loop over bounds
+    for (int b=0; b<numBodies; b++) {                           // Loop over sorted bodies
+      B_iter B = bodies.begin() + keys[b].second;               //  Body iterator
+      B->IRANK = std::upper_bound(keyBegin.begin(), keyBegin.end(), keys[b].first) - keyBegin.begin() - 1;// Send rank
+      assert(0 <= B->IRANK && B->IRANK < mpisize);
+      for (int d=0; d<3; d++) {                                 //  Loop over dimensions
+	localXmin[3*B->IRANK+d] = std::min(localXmin[3*B->IRANK+d], float(B->X[d]));// Update Xmin of send rank
+	localXmax[3*B->IRANK+d] = std::max(localXmax[3*B->IRANK+d], float(B->X[d]));// Update Xmax of send rank
+      }                                                         //  End loop over dimensions
+    }                                                           // End loop over sorted bodies
+    std::vector<float> globalXmin(3*mpisize), globalXmax(3*mpisize);// Reduced bounds per rank
+    MPI_Allreduce(&localXmin[0], &globalXmin[0], 3*mpisize, MPI_FLOAT, MPI_MIN, MPI_COMM_WORLD);// Reduce Xmin
+    MPI_Allreduce(&localXmax[0], &globalXmax[0], 3*mpisize, MPI_FLOAT, MPI_MAX, MPI_COMM_WORLD);// Reduce Xmax
+    for (int irank=0; irank<mpisize; irank++) {                 // Loop over MPI ranks
+      for (int d=0; d<3; d++) {                                 //  Loop over dimensions
+	rankBounds[irank].Xmin[d] = globalXmin[3*irank+d];      //   Xmin of rank
+	rankBounds[irank].Xmax[d] = globalXmax[3*irank+d];      //   Xmax of rank
+      }                                                         //  End loop over dimensions
+    }                                                           // End loop over MPI ranks
+    logger::stopTimer("Partition");                             // Stop timer
+    logger::startTimer("Sort");                                 // Start timer
+    Sort sort;                                                  // Instantiate sort class
+    bodies = sort.irank(bodies);                                // Sort bodies according to IRANK
+    logger::stopTimer("Sort");                                  // Stop timer
+    return rankBounds[mpirank];                                 // Return local bounds
+  }
+
   //! Send bodies back to where they came from
   void unpartition(Bodies & bodies) {
     logger::startTimer("Sort");                                 // Start timer
@@ -0,0 +1,240 @@
+#ifndef refit_tree_h
+#define refit_tree_h
+#include <algorithm>
+#include "logger.h"
+#include "types.h"
+
+//! Refit an existing tree to moved bodies without rebuilding it
+class RefitTree {
+private:
+  const int ncrit;                                              //!< Number of bodies per leaf cell
+  const real_t occupancy;                                       //!< Rebuild when a leaf grows beyond occupancy * ncrit
+  const real_t growth;                                          //!< Rebuild when cell radii grow beyond growth * cube on average
+  int numLeavers;                                               //!< Number of bodies that left their leaf in last refit
+  real_t meanGrowth;                                            //!< Average radius over cube of linked cells in last refit
+  std::vector<real_t> radius;                                   //!< Geometric radius of cells
+  std::vector<std::pair<int,int> > leafs;                       //!< Index of first body and index of leaf cells (body order)
+  std::vector<int> count;                                       //!< Number of bodies per leaf after refit
+  std::vector<int> rank;                                        //!< Position of each leaf in body order
+  std::vector<std::pair<int,int> > leavers;                     //!< New leaf and index of bodies that left their leaf
+  std::vector<std::pair<int,int> > arrivals;                    //!< Leaf rank and index of leavers (arrival order)
+
+private:
+  //! Distance between X and the center of cell C in the max norm
+  real_t distance(vec3 X, C_iter C) {
+    real_t R = 0;                                               // Initialize distance
+    for (int d=0; d<3; d++) R = std::max(R, std::abs(X[d] - C->X[d]));// Largest distance over dimensions
+    return R;                                                   // Return distance
+  }
+
+  //! Find the leaf whose cube contains X, or the nearest leaf if X is outside of the populated octants
+  int findLeaf(vec3 X, C_iter C0) {
+    C_iter C = C0;                                              // Start from root cell
+    while (C->NCHILD != 0) {                                    // While not at a leaf
+      C_iter Cnext = C0 + C->ICHILD;                            //  Nearest child
+      for (C_iter CC=Cnext+1; CC!=C0+C->ICHILD+C->NCHILD; CC++) {// Loop over other child cells
+	if (distance(X, CC) < distance(X, Cnext)) Cnext = CC;   //   Child containing X is the nearest one
+      }                                                         //  End loop over child cells
+      C = Cnext;                                                //  Move down one level
+    }                                                           // End while loop for leaf
+    return C - C0;                                              // Return leaf index
+  }
+
+  //! Recover geometric radius of all cells from the offset of the root's first child
+  void setRadius(Cells & cells) {
+    C_iter C0 = cells.begin();                                  // Root cell
+    C_iter C1 = C0 + C0->ICHILD;                                // First child of root
+    real_t R = 0;                                               // Radius of child cube
+    for (int d=0; d<3; d++) R = std::max(R, std::abs(C1->X[d] - C0->X[d]));// Child center is offset by its radius
+    radius.resize(cells.size());                                // Resize radius vector
+    radius[0] = 2 * R;                                          // Root radius
+    for (C_iter C=C0; C!=cells.end(); C++) {                    // Loop over cells (parents before children)
+      for (C_iter CC=C0+C->ICHILD; CC!=C0+C->ICHILD+C->NCHILD; CC++) {// Loop over child cells
+	radius[CC-C0] = radius[C-C0] / 2;                       //   Child radius is half of parent
+      }                                                         //  End loop over child cells
+    }                                                           // End loop over cells
+  }
+
+  //! Check if cell C is still linked from its parent
+  bool isLinked(C_iter C, C_iter C0) {
+    if (C == C0) return true;                                   // Root cell is always linked
+    C_iter Cparent = C0 + C->IPARENT;                           // Parent cell
+    return C >= C0 + Cparent->ICHILD && C < C0 + Cparent->ICHILD + Cparent->NCHILD;// In range of parent's children
+  }
+
+  //! Unlink empty cell from its parent by swapping it behind the parent's last child
+  void unlinkCell(Cells & cells, int c) {
+    C_iter C0 = cells.begin();                                  // Root cell
+    C_iter Cparent = C0 + cells[c].IPARENT;                     // Parent cell
+    int last = Cparent->ICHILD + Cparent->NCHILD - 1;           // Index of parent's last child
+    if (c != last) {                                            // If cell is not the last child
+      std::swap(cells[c], cells[last]);                         //  Swap with last child
+      std::swap(radius[c], radius[last]);                       //  Swap geometric radius
+      for (C_iter CC=C0+cells[c].ICHILD; CC!=C0+cells[c].ICHILD+cells[c].NCHILD; CC++) {// Loop over children of moved cell
+	CC->IPARENT = c;                                        //   Link to new index of parent
+      }                                                         //  End loop over children of moved cell
+    }                                                           // End if for last child
+    Cparent->NCHILD--;                                          // Unlink from parent
+    if (Cparent->NCHILD == 0) unlinkCell(cells, Cparent-C0);    // Parent without children is also empty
+  }
+
+  //! Update cell radius bottom up so that each cell covers its bodies, returns false if the cells grew too loose
+  bool updateRadius(Cells & cells) {
+    C_iter C0 = cells.begin();                                  // Root cell
+    real_t sumGrowth = 0;                                       // Sum of radius over cube of linked cells
+    int numLinked = 0;                                          // Number of linked cells
+    bool tight = true;                                          // Flag for leafs within their neighbor octants
+    for (int c=cells.size()-1; c>=0; c--) {                     // Loop over cells bottom up
+      C_iter C = C0 + c;                                        //  Current cell
+      C->R = radius[c];                                         //  Start from geometric radius
+      if (C->NCHILD == 0) {                                     //  If leaf cell
+	for (B_iter B=C->BODY; B!=C->BODY+C->NBODY; B++) {      //   Loop over bodies in leaf
+	  C->R = std::max(C->R, distance(B->X, C));             //    Enlarge radius to cover body
+	}                                                       //   End loop over bodies in leaf
+	if (C->R > 3 * radius[c]) tight = false;                //   Leaf reaches beyond its neighbor octant
+      } else {                                                  //  Else if not a leaf
+	for (C_iter CC=C0+C->ICHILD; CC!=C0+C->ICHILD+C->NCHILD; CC++) {// Loop over child cells
+	  C->R = std::max(C->R, distance(CC->X, C) + CC->R);    //    Enlarge radius to cover child
+	}                                                       //   End loop over child cells
+      }                                                         //  End if for leaf cell
+      if (isLinked(C, C0)) {                                    //  If cell is still in the tree
+	sumGrowth += C->R / radius[c];                          //   Accumulate growth of radius
+	numLinked++;                                            //   Increment linked cell counter
+      }                                                         //  End if for linked cell
+    }                                                           // End loop over cells
+    meanGrowth = sumGrowth / numLinked;                         // Average growth of linked cells
+    return tight && meanGrowth <= growth;                       // Larger cells would make the traversal accept fewer pairs
+  }
+
+public:
+  //! Constructor
+  RefitTree(int _ncrit, real_t _occupancy=2, real_t _growth=1.002) :// Constructor
+    ncrit(_ncrit), occupancy(_occupancy), growth(_growth), numLeavers(0), meanGrowth(1) {}// Initialize variables
+
+  //! Refit cells to bodies that moved since the tree was built, returns false if a rebuild is required
+  /*!
+    Bodies must still be in the order of the tree (only their positions changed) and the cells must not have
+    been modified other than by the upward/downward pass. Bodies that left the cube of their leaf are moved to
+    the leaf that now contains them (or the nearest one if their octant was empty at build time). The bodies
+    that stay keep their order and are copied as blocks, and the leavers are appended to their new leaf. Cell
+    centers stay the same and leafs that became empty are unlinked from their parent (they stay in the vector
+    but are unreachable). NBODY/IBODY/BODY are updated, and R is recomputed bottom up so that every cell covers
+    its bodies, so upwardPass can be called next. A rebuild is required (false) if a leaf grew beyond the
+    occupancy threshold, its radius grew beyond three times its cube, or the radii of all cells grew beyond
+    growth times their cube on average. The default growth is tight because the M2L pairs grow much faster
+    than the radii (about 4% at growth 1.004 and 11% at 1.02 for n=300k), while a refit saves only 10% of a
+    build. bounds is recomputed from the moved bodies in either case, so it can be passed on to buildTree and
+    allgatherBounds.
+   */
+  bool refitTree(Bodies & bodies, Bodies & buffer, Cells & cells, Bounds & bounds) {
+    logger::startTimer("Refit tree");                           // Start timer
+    numLeavers = 0;                                             // Initialize leaver counter
+    if (!bodies.empty()) bounds.Xmin = bounds.Xmax = bodies.front().X;// Initialize bounds
+    for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {       // Loop over bodies
+      bounds.Xmin = min(B->X, bounds.Xmin);                     //  Update Xmin
+      bounds.Xmax = max(B->X, bounds.Xmax);                     //  Update Xmax
+    }                                                           // End loop over bodies
+    if (cells.size() < 2 || bodies.size() != size_t(cells.front().NBODY)) {// If tree is trivial or bodies changed
+      logger::stopTimer("Refit tree");                          //  Stop timer
+      return false;                                             //  Rebuild
+    }                                                           // End if for trivial tree
+    const int numBodies = bodies.size();                        // Number of bodies
+    C_iter C0 = cells.begin();                                  // Root cell
+    B_iter B0 = bodies.begin();                                 // First body
+    setRadius(cells);                                           // Recover geometric radius of cells
+    leafs.clear();                                              // Clear leafs in body order
+    for (C_iter C=C0; C!=cells.end(); C++) {                    // Loop over cells
+      if (C->NCHILD == 0) leafs.push_back(std::make_pair(int(C->BODY-B0), int(C-C0)));// Store leaf with its first body
+    }                                                           // End loop over cells
+    std::sort(leafs.begin(), leafs.end());                      // Sort leafs by first body
+    count.assign(cells.size(), 0);                              // Initialize body count per leaf
+    rank.resize(cells.size());                                  // Resize leaf rank vector
+    leavers.clear();                                            // Clear bodies that left their leaf
+    for (size_t l=0; l<leafs.size(); l++) {                     // Loop over leafs in body order
+      int c = leafs[l].second;                                  //  Leaf index
+      C_iter C = C0 + c;                                        //  Leaf cell
+      count[c] += C->NBODY;                                     //  Bodies that stay
+      rank[c] = l;                                              //  Position of leaf in body order
+      for (B_iter B=C->BODY; B!=C->BODY+C->NBODY; B++) {        //  Loop over bodies in leaf
+	if (distance(B->X, C) > radius[c]) {                    //   If body left the cube of its leaf
+	  int i = findLeaf(B->X, C0);                           //    Find its new leaf
+	  if (i != c) {                                         //    If body changed leaf
+	    leavers.push_back(std::make_pair(i, int(B-B0)));    //     Store new leaf and body index
+	    count[c]--;                                         //     Body leaves this leaf
+	    count[i]++;                                         //     Body arrives at new leaf
+	  }                                                     //    End if for new leaf
+	}                                                       //   End if for leaver
+      }                                                         //  End loop over bodies in leaf
+    }                                                           // End loop over leafs
+    numLeavers = leavers.size();                                // Number of bodies that changed leaf
+    if (numLeavers != 0) {                                      // If any body changed leaf
+      for (size_t l=0; l<leafs.size(); l++) {                   //  Loop over leafs
+	C_iter C = C0 + leafs[l].second;                        //   Leaf cell
+	int n = count[leafs[l].second];                         //   New number of bodies
+	if (n > occupancy * ncrit && n > C->NBODY) {            //   If leaf is overfull
+	  logger::stopTimer("Refit tree");                      //    Stop timer
+	  return false;                                         //    Rebuild
+	}                                                       //   End if for occupancy
+      }                                                         //  End loop over leafs
+      arrivals.resize(numLeavers);                              //  Resize arrivals
+      for (int i=0; i<numLeavers; i++) {                        //  Loop over leavers
+	arrivals[i] = std::make_pair(rank[leavers[i].first], leavers[i].second);// Rank of new leaf and body index
+      }                                                         //  End loop over leavers
+      std::sort(arrivals.begin(), arrivals.end());              //  Group leavers by new leaf (stable by body index)
+      buffer.resize(numBodies);                                 //  Resize buffer
+      B_iter B = buffer.begin();                                //  Next body in buffer
+      int k = 0, a = 0;                                         //  Next leaver and next arrival
+      for (size_t l=0; l<leafs.size(); l++) {                   //  Loop over leafs in body order
+	C_iter C = C0 + leafs[l].second;                        //   Leaf cell
+	int begin = C->BODY - B0, end = begin + C->NBODY;       //   Old range of bodies in leaf
+	C->IBODY = B - buffer.begin();                          //   Index of first body
+	for (; k<numLeavers && leavers[k].second<end; k++) {    //   Loop over leavers of leaf (in body order)
+	  B = std::copy(B0+begin, B0+leavers[k].second, B);     //    Copy block of bodies that stay
+	  begin = leavers[k].second + 1;                        //    Skip leaver
+	}                                                       //   End loop over leavers of leaf
+	B = std::copy(B0+begin, B0+end, B);                     //   Copy last block of bodies that stay
+	for (; a<numLeavers && arrivals[a].first==int(l); a++) {//   Loop over bodies arriving at leaf
+	  *B++ = bodies[arrivals[a].second];                    //    Append arriving body
+	}                                                       //   End loop over arrivals
+	C->NBODY = (B - buffer.begin()) - C->IBODY;             //   Number of bodies
+      }                                                         //  End loop over leafs
+      bodies.swap(buffer);                                      //  Refitted bodies become the body vector
+      B0 = bodies.begin();                                      //  First body of refitted vector
+      for (size_t l=0; l<leafs.size(); l++) {                   //  Loop over leafs
+	C_iter C = C0 + leafs[l].second;                        //   Leaf cell
+	C->BODY = B0 + C->IBODY;                                //   Iterator of first body
+      }                                                         //  End loop over leafs
+      for (int c=1; c<int(cells.size()); c++) {                 //  Loop over cells except root
+	while (cells[c].NCHILD == 0 && cells[c].NBODY == 0 && isLinked(C0+c, C0)) {// While cell c is an empty linked leaf
+	  unlinkCell(cells, c);                                 //    Unlink it (another cell may be swapped into c)
+	}                                                       //   End while loop for empty leaf
+      }                                                         //  End loop over cells
+      for (int c=cells.size()-1; c>=0; c--) {                   //  Loop over cells bottom up
+	C_iter C = C0 + c;                                      //   Current cell
+	if (C->NCHILD != 0) {                                   //   If not a leaf
+	  C->NBODY = 0;                                         //    Initialize number of bodies
+	  C->IBODY = numBodies;                                 //    Initialize index of first body
+	  for (C_iter CC=C0+C->ICHILD; CC!=C0+C->ICHILD+C->NCHILD; CC++) {// Loop over child cells
+	    C->NBODY += CC->NBODY;                              //      Accumulate number of bodies
+	    C->IBODY = std::min(C->IBODY, CC->IBODY);           //      First body of first child
+	  }                                                     //     End loop over child cells
+	  C->BODY = B0 + C->IBODY;                              //    Iterator of first body
+	}                                                       //   End if for leaf
+      }                                                         //  End loop over cells
+    }                                                           // End if for leavers
+    bool tight = updateRadius(cells);                           // Update radius bottom up
+    logger::stopTimer("Refit tree");                            // Stop timer
+    return tight;                                               // Refit succeeded if leafs are tight enough
+  }
+
+  //! Print refit statistics
+  void printRefitData() {
+    if (logger::verbose) {                                      // If verbose flag is true
+      std::cout << std::setw(logger::stringLength) << std::left //  Set format
+		<< "Leaving bodies" << " : " << numLeavers << std::endl // Print number of bodies that changed leaf
+		<< std::setw(logger::stringLength) << std::left //  Set format
+		<< "Radius growth" << " : " << meanGrowth << std::endl; // Print average growth of cell radius
+    }                                                           // End if for verbose flag
+  }
+};
+#endif
@@ -0,0 +1,138 @@
+#ifndef sfc_h
+#define sfc_h
+#include <stdint.h>
+
+//! Space filling curve keys (Morton and Hilbert) for octree cells
+namespace sfc {
+  //! Hilbert digit of octant (ix + 2 * iy + 4 * iz) for each of the 24 curve states
+  static const uint8_t hilbertKey[24][8] = {
+    {0, 3, 7, 4, 1, 2, 6, 5},
+    {0, 3, 1, 2, 7, 4, 6, 5},
+    {2, 1, 5, 6, 3, 0, 4, 7},
+    {6, 5, 7, 4, 1, 2, 0, 3},
+    {0, 7, 3, 4, 1, 6, 2, 5},
+    {4, 3, 7, 0, 5, 2, 6, 1},
+    {2, 1, 3, 0, 5, 6, 4, 7},
+    {0, 7, 1, 6, 3, 4, 2, 5},
+    {6, 5, 1, 2, 7, 4, 0, 3},
+    {4, 3, 5, 2, 7, 0, 6, 1},
+    {6, 1, 5, 2, 7, 0, 4, 3},
+    {2, 5, 1, 6, 3, 4, 0, 7},
+    {4, 7, 5, 6, 3, 0, 2, 1},
+    {6, 1, 7, 0, 5, 2, 4, 3},
+    {2, 5, 3, 4, 1, 6, 0, 7},
+    {0, 1, 3, 2, 7, 6, 4, 5},
+    {6, 7, 5, 4, 1, 0, 2, 3},
+    {4, 7, 3, 0, 5, 6, 2, 1},
+    {4, 5, 7, 6, 3, 2, 0, 1},
+    {2, 3, 1, 0, 5, 4, 6, 7},
+    {0, 1, 7, 6, 3, 2, 4, 5},
+    {6, 7, 1, 0, 5, 4, 2, 3},
+    {4, 5, 3, 2, 7, 6, 0, 1},
+    {2, 3, 5, 4, 1, 0, 6, 7}
+  };
+
+  //! Curve state of the child in each octant for each of the 24 curve states
+  static const uint8_t hilbertState[24][8] = {
+    {1, 2, 3, 2, 4, 4, 5, 5},
+    {0, 6, 7, 7, 8, 6, 9, 9},
+    {10, 10, 11, 11, 0, 12, 0, 6},
+    {13, 13, 0, 12, 14, 14, 8, 12},
+    {15, 16, 11, 11, 0, 17, 0, 17},
+    {10, 10, 18, 19, 0, 17, 0, 17},
+    {13, 13, 1, 17, 14, 14, 1, 2},
+    {20, 21, 1, 12, 14, 14, 1, 12},
+    {10, 10, 11, 11, 1, 17, 3, 17},
+    {13, 13, 1, 12, 22, 23, 1, 12},
+    {8, 2, 8, 2, 15, 16, 5, 5},
+    {8, 2, 8, 2, 4, 4, 18, 19},
+    {3, 17, 7, 7, 3, 2, 9, 9},
+    {3, 6, 20, 21, 3, 6, 9, 9},
+    {3, 6, 7, 7, 3, 6, 22, 23},
+    {4, 20, 19, 20, 10, 22, 19, 22},
+    {21, 4, 21, 18, 23, 10, 23, 18},
+    {8, 12, 8, 6, 4, 4, 5, 5},
+    {16, 20, 5, 20, 16, 22, 11, 22},
+    {21, 15, 21, 5, 23, 15, 23, 11},
+    {7, 15, 13, 18, 23, 15, 23, 18},
+    {16, 7, 19, 13, 16, 22, 19, 22},
+    {21, 15, 21, 18, 9, 15, 14, 18},
+    {16, 20, 19, 20, 16, 9, 19, 14}
+  };
+
+  //! Octant of each Hilbert digit for each of the 24 curve states (inverse of hilbertKey)
+  static const uint8_t hilbertOctant[24][8] = {
+    {0, 4, 5, 1, 3, 7, 6, 2},
+    {0, 2, 3, 1, 5, 7, 6, 4},
+    {5, 1, 0, 4, 6, 2, 3, 7},
+    {6, 4, 5, 7, 3, 1, 0, 2},
+    {0, 4, 6, 2, 3, 7, 5, 1},
+    {3, 7, 5, 1, 0, 4, 6, 2},
+    {3, 1, 0, 2, 6, 4, 5, 7},
+    {0, 2, 6, 4, 5, 7, 3, 1},
+    {6, 2, 3, 7, 5, 1, 0, 4},
+    {5, 7, 3, 1, 0, 2, 6, 4},
+    {5, 1, 3, 7, 6, 2, 0, 4},
+    {6, 2, 0, 4, 5, 1, 3, 7},
+    {5, 7, 6, 4, 0, 2, 3, 1},
+    {3, 1, 5, 7, 6, 4, 0, 2},
+    {6, 4, 0, 2, 3, 1, 5, 7},
+    {0, 1, 3, 2, 6, 7, 5, 4},
+    {5, 4, 6, 7, 3, 2, 0, 1},
+    {3, 7, 6, 2, 0, 4, 5, 1},
+    {6, 7, 5, 4, 0, 1, 3, 2},
+    {3, 2, 0, 1, 5, 4, 6, 7},
+    {0, 1, 5, 4, 6, 7, 3, 2},
+    {3, 2, 6, 7, 5, 4, 0, 1},
+    {6, 7, 3, 2, 0, 1, 5, 4},
+    {5, 4, 0, 1, 3, 2, 6, 7}
+  };
+
+  //! Octant of child cell at the given bit of the 3-D index
+  inline int getOctant(int ix, int iy, int iz, int l) {
+    return ((ix >> l) & 1) + (((iy >> l) & 1) << 1) + (((iz >> l) & 1) << 2);
+  }
+
+  //! Interleave bits of 3-D index into Morton key
+  inline uint64_t morton(int ix, int iy, int iz, int level) {
+    uint64_t key = 0;                                           // Initialize Morton key
+    for (int l=level-1; l>=0; l--) {                            // Loop over levels from the root
+      key = (key << 3) | getOctant(ix, iy, iz, l);              //  Append octant
+    }                                                           // End loop over levels
+    return key;                                                 // Return Morton key
+  }
+
+  //! Hilbert key of 3-D index using the state transition tables
+  inline uint64_t hilbert(int ix, int iy, int iz, int level) {
+    uint64_t key = 0;                                           // Initialize Hilbert key
+    int state = 0;                                              // Curve state of root cell
+    for (int l=level-1; l>=0; l--) {                            // Loop over levels from the root
+      int octant = getOctant(ix, iy, iz, l);                    //  Octant of child cell
+      key = (key << 3) | hilbertKey[state][octant];             //  Append Hilbert digit
+      state = hilbertState[state][octant];                      //  Move to state of child cell
+    }                                                           // End loop over levels
+    return key;                                                 // Return Hilbert key
+  }
+
+  //! Morton or Hilbert key of 3-D index
+  inline uint64_t getKey(int ix, int iy, int iz, int level, bool useHilbert) {
+    if (useHilbert) return hilbert(ix, iy, iz, level);          // Hilbert key
+    else return morton(ix, iy, iz, level);                      // Morton key
+  }
+
+  //! Octant visited at position i among the children of a cell in the given curve state
+  inline int childOctant(int state, int i, bool useHilbert) {
+    return useHilbert ? hilbertOctant[state][i] : i;            // Morton order visits octants in index order
+  }
+
+  //! Position of octant among the children of a cell in the given curve state (inverse of childOctant)
+  inline int childIndex(int state, int octant, bool useHilbert) {
+    return useHilbert ? hilbertKey[state][octant] : octant;    // Morton order visits octants in index order
+  }
+
+  //! Curve state of the child cell in the given octant
+  inline int childState(int state, int octant, bool useHilbert) {
+    return useHilbert ? hilbertState[state][octant] : 0;        // Morton order has a single state
+  }
+}
+#endif
@@ -93,6 +93,44 @@ struct SIMD<T,3,2> {
   }
 };
 
+//! Bodies i to i+n-1 with zeros in the remaining lanes (zero SRC masks the lanes in P2P)
+template<typename T, int D>
+struct SIMDTail {
+  static inline T setBody(B_iter B, int i, int n) {
+    T v = 0;
+    for (int k=0; k<n; k++) v[k] = B[i+k].X[D];
+    return v;
+  }
+};
+template<typename T>
+struct SIMDTail<T,3> {
+  static inline T setBody(B_iter B, int i, int n) {
+    T v = 0;
+    for (int k=0; k<n; k++) v[k] = B[i+k].SRC;
+    return v;
+  }
+};
+
+#if USE_SOA
+//! Aligned load of a SIMD vector from contiguous stream p
+template<typename T>
+inline T loadSoA(const real_t * p) {
+  return *reinterpret_cast<const T*>(p);
+}
+
+#endif
+//! Load of a SIMD vector from an address that need not be aligned
+template<typename T>
+inline T loadUnaligned(const real_t * p) {
+  T v;
+  std::memcpy((void*)&v, p, sizeof(T));
+  return v;
+}
+//! Store of a SIMD vector to an address that need not be aligned
+template<typename T>
+inline void storeUnaligned(real_t * p, const T & v) {
+  std::memcpy(p, (const void*)&v, sizeof(T));
+}
 kreal_t transpose(ksimdvec v, int i) {
 #if KAHAN
   kreal_t temp;
@@ -103,4 +141,13 @@ kreal_t transpose(ksimdvec v, int i) {
   return v[i];
 #endif
 }
+kreal_t reduce(ksimdvec v) {
+#if KAHAN
+  kreal_t temp = 0;
+  for (int i=0; i<NSIMD; i++) temp += transpose(v,i);
+  return temp;
+#else
+  return sum(v);
+#endif
+}
 #endif
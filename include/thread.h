@@ -74,4 +74,17 @@ void call(Call C) { C(); }
 
 #endif
 
+//! Number of threads that have been given an index by thread_index()
+inline int & thread_count() {
+  static int count = 0;
+  return count;
+}
+
+//! Index of the calling thread, assigned in order of first call
+inline int thread_index() {
+  static __thread int index = -1;
+  if (index < 0) index = __sync_fetch_and_add(&thread_count(), 1);
+  return index;
+}
+
 #endif
@@ -1,27 +1,101 @@
 #ifndef traversal_h
 #define traversal_h
+#if USE_SOA
+#include "bodies_soa.h"
+#endif
+#include <algorithm>
 #include "kernel.h"
 #include "logger.h"
 #include "thread.h"
-
-#if COUNT
-#define countKernel(N) N++
-#else
-#define countKernel(N)
-#endif
+#include "ewald.h"
 
 class Traversal {
+public:
+  //! Recorded P2P and M2L schedule of one dual tree traversal, indexed by target cell
+  struct Plan {
+    std::vector<int> offset;                                    //!< Offset of the sources of each target cell
+    std::vector<int> numP2P;                                    //!< Number of P2P sources of each target cell (stored before M2L)
+    std::vector<int> source;                                    //!< Index of source cell (-1 for P2P of a cell with itself)
+    std::vector<char> image;                                    //!< Periodic image of source cell (empty if not periodic)
+    std::vector<double> pairsP2P;                               //!< Prefix sum of P2P body pairs over target cells
+    std::vector<int> pairsM2L;                                  //!< Prefix sum of M2L cell pairs over target cells
+  };
+
 private:
   const int nspawn;                                             //!< Threshold of NBODY for spawning new threads
   const int images;                                             //!< Number of periodic image sublevels
   const int eps2;                                               //!< Softening parameter (squared)
-#if COUNT
-  real_t numP2P;                                                //!< Number of P2P kernel calls
-  real_t numM2L;                                                //!< Number of M2L kernel calls
-#endif
+  const int listM2L;                                            //!< Record M2L pairs in lists and evaluate them afterwards
+  kernel::P2PKernel kernelP2P[2];                               //!< P2P kernels specialized for this traversal (without/with mutual)
   C_iter Ci0;                                                   //!< Iterator of first target cell
   C_iter Cj0;                                                   //!< Iterator of first source cell
 
+  //! Interaction list of a target cell
+  struct SourceList {
+    std::vector<C_iter> Cj;                                     //!< Source cells
+    std::vector<vec3> Xperiodic;                                //!< Periodic coordinate offsets of source cells
+  };
+  std::vector<SourceList> lists;                                //!< M2L interaction lists of target cells
+  std::vector<SourceList> p2pLists;                             //!< P2P interaction lists of target cells (while recording)
+  std::vector<int> offsets;                                     //!< Prefix sum of M2L list lengths
+  Plan * plan;                                                  //!< Plan being recorded (NULL if not recording)
+
+  //! Periodic far field as one linear map from the source root multipole to the target root local
+  struct PeriodicOperator {
+    real_t cycle;                                               //!< Periodic cycle the operator was built for
+    vec3 dX;                                                    //!< Distance between target and source root
+    std::vector<ereal_t> T;                                     //!< Operator matrix over real and imaginary parts (row major)
+  };
+  PeriodicOperator periodicOperator;                            //!< Cached periodic operator (empty until the lattice is reused)
+
+  static const int maxLevels = 32;                              //!< Number of tree levels with statistics (deeper levels go to the last)
+  static const int maxBins = 16;                                //!< Number of bins of the M2L list length histogram
+
+  //! Kernel statistics of one thread (padded to a multiple of a cache line)
+  struct ThreadStats {
+    double cyclesP2P;                                           //!< Cycles spent in P2P kernels (COUNT builds only)
+    double cyclesM2L;                                           //!< Cycles spent in M2L kernels (COUNT builds only)
+    double cyclesM2P;                                           //!< Cycles spent in M2P and P2L kernels (COUNT builds only)
+    double numP2P;                                              //!< Number of P2P body pairs
+    double numM2L;                                              //!< Number of M2L kernel calls, one per mutual pair
+    double numM2P;                                              //!< Number of M2P and P2L kernel calls
+    double numTasks;                                            //!< Number of traversal tasks
+    uint64_t levelP2P[maxLevels];                               //!< P2P cell pairs by level of the target cell
+    uint64_t levelM2L[maxLevels];                               //!< M2L cell pairs by level of the target cell
+    uint64_t lengthM2L[maxBins];                                //!< Far field lists with 2^bin to 2^(bin+1)-1 source cells
+    uint64_t lengthM2P[maxBins];                                //!< Group M2P lists with 2^bin to 2^(bin+1)-1 source cells
+    char pad[8];                                                //!< Padding to avoid false sharing
+  };
+  static const int maxThreads = 256;                            //!< Maximum number of threads with statistics
+  static const int directTileSize = 256;                        //!< Maximum number of target bodies per tile of direct summation
+  static const int directBlockBytes = 1 << 18;                  //!< Bytes of source bodies per block of direct summation (L2)
+  std::vector<ThreadStats> threadStats;                         //!< Kernel statistics of each thread
+  std::vector<int> ilevels;                                     //!< Level of each target cell
+  std::vector<int> jlevels;                                     //!< Level of each source cell (if cells differ)
+  std::vector<int> lengths;                                     //!< Far field sources of each target cell in this traversal
+  double cyclesTraverse;                                        //!< Wall clock cycles of all traversals
+  std::vector<uint64_t> countersTraverse;                       //!< PAPI counters of all dual tree traversals
+  double costP2P;                                               //!< Cost model: cycles per P2P body pair
+  double costM2L;                                               //!< Cost model: cycles per M2L cell pair
+  double numP2PBody;                                            //!< Cost model: P2P body pairs per target body
+  double numM2LBody;                                            //!< Cost model: M2L cell pairs per target body
+  std::vector<double> workM2PBody;                              //!< Op-count model: M2P work in units of M2L for each number of target bodies where it is cheaper
+  std::vector<double> workP2LBody;                              //!< Op-count model: P2L work in units of M2L for each number of source bodies where it is cheaper
+  double maxP2PSource;                                          //!< Op-count model: source bodies for which P2P costs as much as M2P
+  double workMutualM2L;                                         //!< Op-count model: cost of a mutual M2L relative to one M2L
+  double spawnCost;                                             //!< Estimated cycles above which tasks are spawned
+  Cells groups;                                                 //!< Target groups of the group traversal
+  std::vector<vec3> groupBox;                                   //!< Half size of the bounding box of each target group
+#if USE_SOA
+  BodiesSoA isoa;                                               //!< SoA copy of target bodies
+  BodiesSoA jsoa;                                               //!< SoA copy of source bodies
+  BodiesSoA gsoa;                                               //!< SoA copy of target groups
+#endif
+#if CHECK_RACE
+  std::vector<int> iwriters;                                    //!< Number of tasks writing to each target cell
+  std::vector<int> jwriters;                                    //!< Number of tasks writing to each source cell
+#endif
+
 private:
 #if USE_WEIGHT
   //! Accumulate interaction weights of cells
@@ -33,35 +107,377 @@ private:
   void countWeight(C_iter, C_iter, bool, real_t) {}
 #endif
 
+#if CHECK_RACE
+  //! Writer count of a source cell (shared with the target cells if the cell vectors are the same)
+  int & getWriters(C_iter Cj) {
+    return Cj0 == Ci0 ? iwriters[Cj-Cj0] : jwriters[Cj-Cj0];    // Writer count of source cell
+  }
+
+  //! Mark the cells written by an interaction and check that no other task is writing them
+  void lockCells(C_iter Ci, C_iter Cj, bool mutual) {
+    int writers = __sync_fetch_and_add(&iwriters[Ci-Ci0], 1);   // Previous writers of target cell
+    assert(writers == 0);                                       // TraverseRange never runs two writers at once
+    if (mutual && (Cj0 != Ci0 || Ci != Cj)) {                   // If source cell is written too
+      writers = __sync_fetch_and_add(&getWriters(Cj), 1);       //  Previous writers of source cell
+      assert(writers == 0);                                     //  TraverseRange never runs two writers at once
+    }                                                           // End if for source cell
+  }
+
+  //! Release the cells written by an interaction
+  void unlockCells(C_iter Ci, C_iter Cj, bool mutual) {
+    __sync_fetch_and_sub(&iwriters[Ci-Ci0], 1);                 // Release target cell
+    if (mutual && (Cj0 != Ci0 || Ci != Cj)) {                   // If source cell was written too
+      __sync_fetch_and_sub(&getWriters(Cj), 1);                 //  Release source cell
+    }                                                           // End if for source cell
+  }
+#else
+  void lockCells(C_iter, C_iter, bool) {}
+  void unlockCells(C_iter, C_iter, bool) {}
+#endif
+
+  //! Statistics of the calling thread
+  ThreadStats & getThreadStats() {
+    return threadStats[thread_index() % maxThreads];            // Slot of this thread
+  }
+
+  //! Start the cycle counter of a kernel call
+  static uint64_t startCount() {
+#if COUNT
+    return logger::get_cycle();                                 // Read cycle counter
+#else
+    return 0;                                                   // No cycle counter
+#endif
+  }
+
+  //! Cycles since tic (COUNT builds only)
+  static uint64_t stopCount(uint64_t tic) {
+#if COUNT
+    return logger::get_cycle() - tic;                           // Read cycle counter
+#else
+    return tic;                                                 // No cycle counter (tic is 0)
+#endif
+  }
+
+  //! Count body pairs (and cycles) of P2P calls that started at tic
+  void countP2P(double numPairs, uint64_t tic) {
+    ThreadStats & stats = getThreadStats();                     // Statistics of this thread
+    stats.cyclesP2P += stopCount(tic);                          // Accumulate P2P cycles
+    stats.numP2P += numPairs;                                   // Count P2P body pairs
+  }
+
+  //! Count cell pairs (and cycles) of M2L calls that started at tic
+  void countM2L(int numPairs, uint64_t tic) {
+    ThreadStats & stats = getThreadStats();                     // Statistics of this thread
+    stats.cyclesM2L += stopCount(tic);                          // Accumulate M2L cycles
+    stats.numM2L += numPairs;                                   // Count M2L cell pairs
+  }
+
+  //! Count calls (and cycles) of M2P and P2L calls that started at tic
+  void countM2P(int numCalls, uint64_t tic) {
+    ThreadStats & stats = getThreadStats();                     // Statistics of this thread
+    stats.cyclesM2P += stopCount(tic);                          // Accumulate M2P and P2L cycles
+    stats.numM2P += numCalls;                                   // Count M2P and P2L calls
+  }
+
+  //! Count a P2P pair at the level of Ci (and of Cj for mutual)
+  void countLevelP2P(C_iter Ci, C_iter Cj, bool mutual) {
+    ThreadStats & stats = getThreadStats();                     // Statistics of this thread
+    stats.levelP2P[getLevelI(Ci)]++;                            // Count P2P at level of target cell
+    if (mutual && Ci != Cj) stats.levelP2P[getLevelJ(Cj)]++;    // Count P2P at level of source cell
+  }
+
+  //! Count an M2L pair at the level of Ci (and of Cj for mutual)
+  void countLevelM2L(C_iter Ci, C_iter Cj, bool mutual) {
+    ThreadStats & stats = getThreadStats();                     // Statistics of this thread
+    stats.levelM2L[getLevelI(Ci)]++;                            // Count M2L at level of target cell
+    if (mutual) stats.levelM2L[getLevelJ(Cj)]++;                // Count M2L at level of source cell
+  }
+
+  //! Count a far field source of Ci (and of Cj for mutual) for the list length histogram
+  void countFar(C_iter Ci, C_iter Cj, bool mutual) {
+    lengths[Ci-Ci0]++;                                          // Cells are written by one task at a time
+    if (mutual && Cj0 == Ci0) lengths[Cj-Ci0]++;                // Source cell is a target cell too
+  }
+
+  //! Sum of the statistics of all threads
+  ThreadStats sumThreadStats() {
+    ThreadStats sum = ThreadStats();                            // Initialize sum
+    for (int i=0; i<maxThreads; i++) {                          // Loop over threads
+      sum.cyclesP2P += threadStats[i].cyclesP2P;                //  Accumulate P2P cycles
+      sum.cyclesM2L += threadStats[i].cyclesM2L;                //  Accumulate M2L cycles
+      sum.cyclesM2P += threadStats[i].cyclesM2P;                //  Accumulate M2P and P2L cycles
+      sum.numP2P += threadStats[i].numP2P;                      //  Accumulate P2P body pairs
+      sum.numM2L += threadStats[i].numM2L;                      //  Accumulate M2L cell pairs
+      sum.numM2P += threadStats[i].numM2P;                      //  Accumulate M2P and P2L calls
+      sum.numTasks += threadStats[i].numTasks;                  //  Accumulate traversal tasks
+      for (int l=0; l<maxLevels; l++) {                         //  Loop over levels
+	sum.levelP2P[l] += threadStats[i].levelP2P[l];          //   Accumulate P2P cell pairs
+	sum.levelM2L[l] += threadStats[i].levelM2L[l];          //   Accumulate M2L cell pairs
+      }                                                         //  End loop over levels
+      for (int b=0; b<maxBins; b++) {                           //  Loop over bins
+	sum.lengthM2L[b] += threadStats[i].lengthM2L[b];        //   Accumulate list length histogram
+	sum.lengthM2P[b] += threadStats[i].lengthM2P[b];        //   Accumulate M2P list length histogram
+      }                                                         //  End loop over bins
+    }                                                           // End loop over threads
+    return sum;                                                 // Return sum
+  }
+
+  //! Measure the P2P and M2L kernels on a pair of synthetic cells to seed the task spawning cost model
+  void calibrate() {
+    const int n = 64;                                           // Number of bodies per cell
+    Bodies bodies(2 * n);                                       // Bodies of both cells
+    for (int i=0; i<2*n; i++) {                                 // Loop over bodies
+      for (int d=0; d<3; d++) {                                 //  Loop over dimensions
+        bodies[i].X[d] = ((i * 7 + d * 13) % 64) / 64.0;        //   Spread bodies over a unit cube
+      }                                                         //  End loop over dimensions
+      if (i >= n) bodies[i].X[0] += 4;                          //  Move second cell away
+      bodies[i].SRC = 1.0 / n;                                  //  Source value
+      bodies[i].TRG = 0;                                        //  Clear target values
+    }                                                           // End loop over bodies
+    Cells cells(2);                                             // Target and source cell
+    for (int i=0; i<2; i++) {                                   // Loop over cells
+      cells[i].BODY = bodies.begin() + i * n;                   //  Iterator of first body
+      cells[i].NBODY = n;                                       //  Number of bodies
+      cells[i].X = .5;                                          //  Cell center
+      cells[i].X[0] += i * 4;                                   //  Move second cell away
+      cells[i].R = .9;                                          //  Cell radius
+      cells[i].ORDER = P;                                       //  Full expansion order
+      cells[i].M = 0;                                           //  Clear multipoles
+      cells[i].L = 0;                                           //  Clear locals
+    }                                                           // End loop over cells
+#if USE_SOA
+    BodiesSoA soa;                                              // SoA copy of bodies
+    soa.scatter(cells);                                         // Both cells are leafs
+#endif
+    C_iter Ci = cells.begin(), Cj = cells.begin() + 1;          // Target and source cell
+    kernel::P2M(Ci);                                            // Multipoles of target cell
+    kernel::P2M(Cj);                                            // Multipoles of source cell
+    const int numRepeat = 8;                                    // Number of timed calls
+    uint64_t tic = logger::get_cycle();                         // Start cycle counter
+    for (int i=0; i<numRepeat; i++) kernel::P2P(Ci, Cj, eps2, vec3(0), false);// Time P2P kernel
+    costP2P = double(logger::get_cycle() - tic) / (numRepeat * n * n);// Cycles per body pair
+    costM2L = 1e30;                                             // Fastest M2L call
+    for (int i=0; i<numRepeat; i++) {                           // Loop over timed calls (fastest is not interrupted)
+      tic = logger::get_cycle();                                //  Start cycle counter
+      kernel::M2L(Ci, Cj, vec3(0), false);                      //  M2L kernel
+      costM2L = std::min(costM2L, double(logger::get_cycle() - tic));// Cycles per cell pair
+    }                                                           // End loop over timed calls
+  }
+
+  //! Break even bodies of M2P and P2L and work of a mutual M2L from the op-count model of the kernels
+  void setFarCost() {
+    double opsM2L = kernel::M2LOps(false);                      // Ops of one M2L
+    workM2PBody.clear();                                        // Clear M2P work
+    for (int n=0; kernel::M2POps(n) < opsM2L; n++) {            // Loop over target bodies while M2P is cheaper
+      workM2PBody.push_back(kernel::M2POps(n) / opsM2L);        //  M2P work in units of M2L
+    }                                                           // End loop over target bodies
+    workP2LBody.clear();                                        // Clear P2L work
+    for (int n=0; kernel::P2LOps(n) < opsM2L; n++) {            // Loop over source bodies while P2L is cheaper
+      workP2LBody.push_back(kernel::P2LOps(n) / opsM2L);        //  P2L work in units of M2L
+    }                                                           // End loop over source bodies
+    maxP2PSource = kernel::M2POps(NSIMDE) / (NSIMDE * kernel::P2POps());// Source bodies per M2P of a full SIMD vector
+    workMutualM2L = kernel::M2LOps(true) / opsM2L;              // Mutual M2L in units of M2L
+  }
+
+  //! Estimated cycles of the interactions between two groups of bodies
+  double getCost(double ni, double nj) {
+    return ni * (std::min(nj, numP2PBody) * costP2P + std::min(nj, numM2LBody) * costM2L)
+      + nj * (std::min(ni, numP2PBody) * costP2P + std::min(ni, numM2LBody) * costM2L);
+  }
+
+  //! Number of bodies in a range of cells
+  static int countBodies(C_iter CBegin, C_iter CEnd) {
+    int numBodies = 0;                                          // Initialize counter
+    for (C_iter C=CBegin; C!=CEnd; C++) numBodies += C->NBODY;  // Accumulate bodies of cells
+    return numBodies;                                           // Return number of bodies
+  }
+
+  //! Split a range of at least two cells into halves with equal number of bodies
+  static C_iter splitRange(C_iter NBegin, C_iter NEnd) {
+    int numBodies = countBodies(NBegin, NEnd);                  // Number of bodies in range
+    int numLeft = NBegin->NBODY;                                // Bodies in left half
+    C_iter NMid = NBegin + 1;                                   // Keep left half non-empty
+    while (NMid + 1 != NEnd && 2 * (numLeft + NMid->NBODY) <= numBodies) {// While left half is lighter
+      numLeft += NMid->NBODY;                                   //  Move cell to left half
+      NMid++;                                                   //  Increment split point
+    }                                                           // End while loop for left half
+    return NMid;                                                // Return split point
+  }
+
+  //! Level of each cell (parents are stored before their children)
+  void getLevels(Cells & cells, std::vector<int> & levels) {
+    levels.resize(cells.size());                                // Allocate one level per cell
+    if (!cells.empty()) levels[0] = 0;                          // Root is at level 0
+    for (int i=0; i<int(cells.size()); i++) {                   // Loop over cells
+      C_iter C = cells.begin() + i;                             //  Iterator of cell
+      for (int c=C->ICHILD; c<C->ICHILD+C->NCHILD; c++) {       //  Loop over child cells
+	levels[c] = levels[i] + 1;                              //   One level below parent
+      }                                                         //  End loop over child cells
+    }                                                           // End loop over cells
+  }
+
+  //! Level of a target cell for the statistics
+  int getLevelI(C_iter Ci) {
+    return std::min(ilevels[Ci-Ci0], maxLevels-1);              // Clamp deep levels to the last level
+  }
+
+  //! Level of a source cell for the statistics
+  int getLevelJ(C_iter Cj) {
+    return std::min(Cj0 == Ci0 ? ilevels[Cj-Cj0] : jlevels[Cj-Cj0], maxLevels-1);// Clamp deep levels to the last level
+  }
+
+  //! Histogram bin of a far field list with n source cells (n > 0)
+  static int getBin(int n) {
+    int bin = 0;                                                // Bin of a single source cell
+    while (n > 1 && bin < maxBins-1) {                          // While list is longer than the bin
+      n >>= 1;                                                  //  Halve length
+      bin++;                                                    //  Next bin
+    }                                                           // End while loop for bins
+    return bin;                                                 // Return bin
+  }
+
+  //! Prefetch an expansion into cache (rw=1 if it will be written)
+  template<int rw>
+  static void prefetch(const vecP & E) {
+    const char * p = reinterpret_cast<const char*>(&E);         // First byte of expansion
+    for (int i=0; i<int(sizeof(vecP)); i+=64) __builtin_prefetch(p+i, rw);// Loop over cache lines of expansion
+  }
+
+  //! Prefetch the expansions that the pair Ci, Cj will touch if it passes the multipole acceptance criterion
+  void prefetchFar(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
+    vec3 dX = Ci->X - Cj->X - Xperiodic;                        // Distance vector from source to target
+    if (norm(dX) <= (Ci->R+Cj->R) * (Ci->R+Cj->R)) return;      // Pair will be split or P2P
+    prefetch<1>(Ci->L);                                         // Target local expansion
+    prefetch<0>(Cj->M);                                         // Source multipole expansion
+    if (mutual) {                                               // If source is updated too
+      prefetch<0>(Ci->M);                                       //  Target multipole expansion
+      prefetch<1>(Cj->L);                                       //  Source local expansion
+    }                                                           // End if for mutual
+  }
+
+  //! Append an M2L pair to the list of its target cell (and of its source cell for mutual)
+  void appendM2L(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
+    if (mutual && Cj0 != Ci0) {                                 // If source cell has no list of its own
+      kernel::M2L(Ci, Cj, Xperiodic, mutual);                   //  M2L kernel
+      return;                                                   //  Nothing to record
+    }                                                           // End if for source cell without list
+    SourceList & listi = lists[Ci-Ci0];                            // List of target cell
+    listi.Cj.push_back(Cj);                                     // Append source cell
+    listi.Xperiodic.push_back(Xperiodic);                       // Append periodic offset
+    if (mutual) {                                               // If mutual interaction
+      SourceList & listj = lists[Cj-Ci0];                          //  List of source cell
+      listj.Cj.push_back(Ci);                                   //  Append target cell as source
+      listj.Xperiodic.push_back(-Xperiodic);                    //  Append reversed periodic offset
+    }                                                           // End if for mutual interaction
+  }
+
+  //! Append a P2P pair to the list of its target cell (and of its source cell for mutual)
+  void appendP2P(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
+    SourceList & listi = p2pLists[Ci-Ci0];                      // List of target cell
+    listi.Cj.push_back(Cj);                                     // Append source cell
+    listi.Xperiodic.push_back(Xperiodic);                       // Append periodic offset
+    if (mutual && Ci != Cj) {                                   // If mutual interaction between different cells
+      SourceList & listj = p2pLists[Cj-Ci0];                    //  List of source cell
+      listj.Cj.push_back(Ci);                                   //  Append target cell as source
+      listj.Xperiodic.push_back(-Xperiodic);                    //  Append reversed periodic offset
+    }                                                           // End if for mutual interaction
+  }
+
+  //! M2L kernel right away, or appended to the M2L lists if they are evaluated later
+  void M2L(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
+    countLevelM2L(Ci, Cj, mutual);                              // Count M2L at level of target (and source) cell
+    if (listM2L || plan) {                                      // If M2L is evaluated from lists later
+      appendM2L(Ci, Cj, Xperiodic, mutual);                     //  Append pair to M2L lists
+    } else {                                                    // Else evaluate M2L right away
+      uint64_t tic = startCount();                              //  Start cycle counter
+      kernel::M2L(Ci, Cj, Xperiodic, mutual);                   //  M2L kernel
+      countM2L(1, tic);                                         //  Count M2L cell pair
+    }                                                           // End if for M2L lists
+  }
+
+  //! Far field kernel of Cj on Ci (0:M2L, 1:M2P, 2:P2L) that is cheapest for their number of bodies
+  double getFarKernel(C_iter Ci, C_iter Cj, int & kernel) {
+    kernel = 0;                                                 // M2L unless something is cheaper
+    if (plan) return 1;                                         // Plans only hold M2L for the far field
+    double workM2P = 1, workP2L = 1;                            // M2P and P2L work in units of M2L
+    if (Ci->NCHILD == 0 && Ci->NBODY < int(workM2PBody.size())) workM2P = workM2PBody[Ci->NBODY];// Few target bodies in leaf
+    if (Cj->NCHILD == 0 && Cj->NBODY < int(workP2LBody.size()) && Cj->NBODY != 0) workP2L = workP2LBody[Cj->NBODY];// Few source bodies in leaf
+    if (workM2P < 1 && workM2P <= workP2L) kernel = 1;          // M2P if it is cheapest
+    else if (workP2L < 1) kernel = 2;                           // P2L if it is cheapest
+    return std::min(std::min(workM2P, workP2L), 1.0);           // Return work in units of M2L
+  }
+
+  //! Far field between a pair of well separated cells by M2L, M2P or P2L for each direction
+  void farField(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
+    int kernelI, kernelJ = 0;                                   // Kernels for Cj -> Ci and Ci -> Cj
+    double work = getFarKernel(Ci, Cj, kernelI);                // Work of cheapest kernel for Cj -> Ci
+    if (mutual) {                                               // If mutual interaction
+      work += getFarKernel(Cj, Ci, kernelJ);                    //  Work of cheapest kernel for Ci -> Cj
+      if (work >= workMutualM2L) kernelI = kernelJ = 0;         //  Mutual M2L shares work between directions
+    }                                                           // End if for mutual interaction
+    if (kernelI == 0 && kernelJ == 0) {                         // If M2L is cheapest for both directions
+      M2L(Ci, Cj, Xperiodic, mutual);                           //  M2L kernel
+      return;                                                   //  Done
+    }                                                           // End if for M2L
+    uint64_t tic = startCount();                                // Start cycle counter
+    if (kernelI == 1) kernel::M2P(Ci, Cj, Xperiodic);           // M2P kernel to bodies of Ci
+    if (kernelI == 2) kernel::P2L(Ci, Cj, Xperiodic);           // P2L kernel from bodies of Cj
+    if (kernelJ == 1) kernel::M2P(Cj, Ci, -Xperiodic);          // M2P kernel to bodies of Cj
+    if (kernelJ == 2) kernel::P2L(Cj, Ci, -Xperiodic);          // P2L kernel from bodies of Ci
+    countM2P((kernelI != 0) + (kernelJ != 0), tic);             // Count M2P and P2L calls
+    if (kernelI == 0) {                                         // If M2L is cheapest for Cj -> Ci
+      M2L(Ci, Cj, Xperiodic, false);                            //  M2L kernel
+    } else if (mutual && kernelJ == 0) {                        // Else if M2L is cheapest for Ci -> Cj
+      tic = startCount();                                       //  Start cycle counter
+      kernel::M2L(Cj, Ci, -Xperiodic, false);                   //  M2L kernel (Cj may not have a list)
+      countM2L(1, tic);                                         //  Count M2L cell pair
+      getThreadStats().levelM2L[getLevelJ(Cj)]++;               //  Count M2L at level of source cell
+    }                                                           // End if for M2L
+  }
+
   //! Dual tree traversal for a single pair of cells
   void traverse(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual, real_t remote) {
     vec3 dX = Ci->X - Cj->X - Xperiodic;                        // Distance vector from source to target
     real_t R2 = norm(dX);                                       // Scalar distance squared
     if (R2 > (Ci->R+Cj->R) * (Ci->R+Cj->R)) {                   // If distance is far enough
-      kernel::M2L(Ci, Cj, Xperiodic, mutual);                   //  M2L kernel
-      countKernel(numM2L);                                      //  Increment M2L counter
+      lockCells(Ci, Cj, mutual);                                //  Check exclusive access to cells
+      farField(Ci, Cj, Xperiodic, mutual);                      //  M2L, M2P or P2L kernels
+      countFar(Ci, Cj, mutual);                                 //  Count far field sources
       countWeight(Ci, Cj, mutual, remote);                      //  Increment M2L weight
+      unlockCells(Ci, Cj, mutual);                              //  Release cells
     } else if (Ci->NCHILD == 0 && Cj->NCHILD == 0) {            // Else if both cells are bodies
+      lockCells(Ci, Cj, mutual);                                //  Check exclusive access to cells
       if (Cj->NBODY == 0) {                                     //  If the bodies weren't sent from remote node
 	std::cout << "Warning: icell " << Ci->ICELL << " needs bodies from jcell" << Cj->ICELL << std::endl;
-	kernel::M2L(Ci, Cj, Xperiodic, mutual);                 //   M2L kernel
-        countKernel(numM2L);                                    //   Increment M2L counter
+	M2L(Ci, Cj, Xperiodic, mutual);                         //   M2L kernel
+	countFar(Ci, Cj, mutual);                               //   Count far field sources
 	countWeight(Ci, Cj, mutual, remote);                    //   Increment M2L weight
       } else {                                                  //  Else if the bodies were sent
+	uint64_t tic = startCount();                            //   Start cycle counter
 	if (R2 == 0 && Ci == Cj) {                              //   If source and target are same
 	  kernel::P2P(Ci, eps2);                                //    P2P kernel for single cell
 	} else {                                                //   Else if source and target are different
-	  kernel::P2P(Ci, Cj, eps2, Xperiodic, mutual);         //    P2P kernel for pair of cells
+	  kernelP2P[mutual](Ci, Cj, eps2, Xperiodic);           //    P2P kernel for pair of cells
 	}                                                       //   End if for same source and target
-	countKernel(numP2P);                                    //   Increment P2P counter
+	countP2P(double(Ci->NBODY) * Cj->NBODY, tic);           //   Count P2P body pairs
+	countLevelP2P(Ci, Cj, mutual);                          //   Count P2P at level of target (and source) cell
+	if (plan) appendP2P(Ci, Cj, Xperiodic, mutual);         //   Record P2P pair in plan
 	countWeight(Ci, Cj, mutual, remote);                    //   Increment P2P weight
       }                                                         //  End if for bodies
+      unlockCells(Ci, Cj, mutual);                              //  Release cells
     } else {                                                    // Else if cells are close but not bodies
       splitCell(Ci, Cj, Xperiodic, mutual, remote);             //  Split cell and call function recursively for child
     }                                                           // End if for multipole acceptance
   }
 
   //! Recursive functor for dual tree traversal of a range of Ci and Cj
+  /*!
+    The four quarters of a range pair run in two rounds, (Ci:former,Cj:former) with
+    (Ci:latter,Cj:latter) and then (Ci:former,Cj:latter) with (Ci:latter,Cj:former).
+    Tasks running at the same time touch disjoint subtrees on both sides, so mutual
+    interactions can update Ci and Cj without locks. For mutual self ranges only one
+    of the off-diagonal quarters runs. Builds with CHECK_RACE check this with lockCells().
+  */
   struct TraverseRange {
     Traversal * traversal;                                      //!< Traversal object
     C_iter CiBegin;                                             //!< Begin iterator of target cells
@@ -81,20 +497,20 @@ private:
     void operator() () {                                        // Overload operator()
       Tracer tracer;                                            //  Instantiate tracer
       logger::startTracer(tracer);                              //  Start tracer
-      if (CiEnd - CiBegin == 1 || CjEnd - CjBegin == 1) {       //  If only one cell in range
-	if (CiBegin == CjBegin) {                               //   If Ci == Cj
-	  assert(CiEnd == CjEnd);                               //    Check if mutual & self interaction
-	  traversal->traverse(CiBegin, CjBegin, Xperiodic, mutual, remote);// Call traverse for single pair
-	} else {                                                //   If Ci != Cj
-	  for (C_iter Ci=CiBegin; Ci!=CiEnd; Ci++) {            //    Loop over all Ci cells
-	    for (C_iter Cj=CjBegin; Cj!=CjEnd; Cj++) {          //     Loop over all Cj cells
-	      traversal->traverse(Ci, Cj, Xperiodic, mutual, remote); // Call traverse for single pair
-	    }                                                   //     End loop over all Cj cells
-	  }                                                     //    End loop over all Ci cells
-	}                                                       //   End if for Ci == Cj
+      traversal->getThreadStats().numTasks++;                   //  Count traversal task
+      double cost = traversal->getCost(countBodies(CiBegin, CiEnd), countBodies(CjBegin, CjEnd));// Estimated cycles
+      if (CiEnd - CiBegin == 1 || CjEnd - CjBegin == 1 || cost < traversal->spawnCost) {// If range is too small to split
+	bool self = mutual && CiBegin == CjBegin;               //   Flag for mutual & self interaction
+	assert(!self || CiEnd == CjEnd);                        //   Check if mutual & self interaction
+	for (C_iter Ci=CiBegin; Ci!=CiEnd; Ci++) {              //   Loop over all Ci cells
+	  for (C_iter Cj=self ? Ci : CjBegin; Cj!=CjEnd; Cj++) {//    Loop over all Cj cells (only Cj >= Ci for self)
+	    if (Cj+1 != CjEnd) traversal->prefetchFar(Ci, Cj+1, Xperiodic, mutual);// Prefetch next pair
+	    traversal->traverse(Ci, Cj, Xperiodic, mutual, remote);// Call traverse for single pair
+	  }                                                     //    End loop over all Cj cells
+	}                                                       //   End loop over all Ci cells
       } else {                                                  //  If many cells are in the range
-	C_iter CiMid = CiBegin + (CiEnd - CiBegin) / 2;         //   Split range of Ci cells in half
-	C_iter CjMid = CjBegin + (CjEnd - CjBegin) / 2;         //   Split range of Cj cells in half
+	C_iter CiMid = splitRange(CiBegin, CiEnd);              //   Split range of Ci cells into equal bodies
+	C_iter CjMid = splitRange(CjBegin, CjEnd);              //   Split range of Cj cells into equal bodies
 	mk_task_group;                                          //   Initialize task group
 	{
 	  TraverseRange leftBranch(traversal, CiBegin, CiMid,   //    Instantiate recursive functor
@@ -123,16 +539,322 @@ private:
     }                                                           // End overload operator()
   };
 
-  //! Tree traversal of periodic cells
-  void traversePeriodic(real_t cycle) {
-    logger::startTimer("Traverse periodic");                    // Start timer
+  //! Recursive functor for evaluating the M2L lists of a range of target cells
+  struct M2LRange {
+    Traversal * traversal;                                      //!< Traversal object
+    int begin;                                                  //!< Index of first target cell
+    int end;                                                    //!< Index of last target cell + 1
+    M2LRange(Traversal * _traversal, int _begin, int _end) :    // Constructor
+      traversal(_traversal), begin(_begin), end(_end) {}        // Initialize variables
+    void operator() () {                                        // Overload operator()
+      std::vector<int> & offsets = traversal->offsets;          //  Prefix sum of list lengths
+      int work = offsets[end] - offsets[begin];                 //  Number of M2L pairs in range
+      if (end - begin == 1 || work * traversal->costM2L < traversal->spawnCost) {// If range is small enough
+	for (int i=begin; i<end; i++) {                         //   Loop over target cells
+	  SourceList & list = traversal->lists[i];              //    M2L list of target cell
+	  if (list.Cj.empty()) continue;                        //    Skip cells without M2L
+	  uint64_t tic = traversal->startCount();               //    Start cycle counter
+	  kernel::M2L(traversal->Ci0+i, &list.Cj[0], &list.Xperiodic[0], list.Cj.size());// Batched M2L kernel
+	  traversal->countM2L(list.Cj.size(), tic);             //    Count M2L cell pairs
+	  list.Cj.clear();                                      //    Empty list but keep its memory
+	  list.Xperiodic.clear();                               //    Empty offsets but keep their memory
+	}                                                       //   End loop over target cells
+      } else {                                                  //  If range has much work
+	int mid = std::lower_bound(offsets.begin()+begin+1, offsets.begin()+end,// Split range into halves of equal work
+				   offsets[begin]+work/2) - offsets.begin();
+	if (mid == end) mid--;                                  //   Keep both halves non-empty
+	mk_task_group;                                          //   Initialize task group
+	M2LRange leftBranch(traversal, begin, mid);             //   Instantiate recursive functor
+	create_taskc(leftBranch);                               //   Create new task for left branch
+	M2LRange rightBranch(traversal, mid, end);              //   Instantiate recursive functor
+	rightBranch();                                          //   Use old task for right branch
+	wait_tasks;                                             //   Synchronize task group
+      }                                                         //  End if for small range
+    }                                                           // End overload operator()
+  };
+
+  //! Evaluate the recorded M2L lists, balancing threads by list length
+  void evalM2L() {
+    offsets.resize(lists.size()+1);                             // Allocate prefix sum
+    offsets[0] = 0;                                             // Initialize prefix sum
+    for (int i=0; i<int(lists.size()); i++) {                   // Loop over target cells
+      offsets[i+1] = offsets[i] + lists[i].Cj.size();           //  Accumulate list lengths
+    }                                                           // End loop over target cells
+    M2LRange m2lRange(this, 0, lists.size());                   // Instantiate recursive functor
+    m2lRange();                                                 // Evaluate lists of all target cells
+  }
+
+  //! Index of a periodic image among the 27 neighbors of the center cell
+  static int getImage(vec3 Xperiodic, real_t cycle) {
+    int image = 0;                                              // Index of periodic image
+    for (int d=0; d<3; d++) {                                   // Loop over dimensions
+      image = image * 3 + int(std::floor(Xperiodic[d] / cycle + .5)) + 1;// Shift -1,0,1 to 0,1,2
+    }                                                           // End loop over dimensions
+    return image;                                               // Return index of periodic image
+  }
+
+  //! Periodic coordinate offset of a periodic image
+  static vec3 getXperiodic(int image, real_t cycle) {
+    vec3 Xperiodic;                                             // Periodic coordinate offset
+    for (int d=2; d>=0; d--) {                                  // Loop over dimensions
+      Xperiodic[d] = (image % 3 - 1) * cycle;                   //  Coordinate offset for this dimension
+      image /= 3;                                               //  Next dimension
+    }                                                           // End loop over dimensions
+    return Xperiodic;                                           // Return periodic coordinate offset
+  }
+
+  //! Append a source cell to the plan being recorded
+  void appendPlan(C_iter Ci, C_iter Cj, vec3 Xperiodic, real_t cycle) {
+    bool self = Ci0 == Cj0 && Ci == Cj && norm(Xperiodic) == 0;// Flag for P2P of a cell with itself
+    plan->source.push_back(self ? -1 : int(Cj-Cj0));            // Append index of source cell
+    if (images != 0) plan->image.push_back(getImage(Xperiodic, cycle));// Append periodic image
+  }
+
+  //! Copy the recorded P2P and M2L lists into the plan
+  void savePlan(real_t cycle) {
+    int numCells = lists.size();                                // Number of target cells
+    plan->offset.resize(numCells+1);                            // Allocate offsets
+    plan->numP2P.resize(numCells);                              // Allocate number of P2P sources
+    plan->pairsP2P.resize(numCells+1);                          // Allocate prefix sum of P2P body pairs
+    plan->pairsM2L.resize(numCells+1);                          // Allocate prefix sum of M2L cell pairs
+    plan->source.clear();                                       // Clear source cells
+    plan->image.clear();                                        // Clear periodic images
+    plan->offset[0] = 0;                                        // Initialize offsets
+    plan->pairsP2P[0] = 0;                                      // Initialize prefix sum of P2P body pairs
+    plan->pairsM2L[0] = 0;                                      // Initialize prefix sum of M2L cell pairs
+    for (int i=0; i<numCells; i++) {                            // Loop over target cells
+      SourceList & p2p = p2pLists[i];                           //  P2P list of target cell
+      SourceList & m2l = lists[i];                              //  M2L list of target cell
+      plan->numP2P[i] = p2p.Cj.size();                          //  Number of P2P sources
+      int numSources = 0;                                       //  Number of P2P source bodies
+      for (int k=0; k<int(p2p.Cj.size()); k++) {                //  Loop over P2P sources
+        appendPlan(Ci0+i, p2p.Cj[k], p2p.Xperiodic[k], cycle);  //   Append P2P source to plan
+        numSources += p2p.Cj[k]->NBODY;                         //   Count source bodies
+      }                                                         //  End loop over P2P sources
+      plan->pairsP2P[i+1] = plan->pairsP2P[i] + double((Ci0+i)->NBODY) * numSources;// Accumulate P2P body pairs
+      plan->pairsM2L[i+1] = plan->pairsM2L[i] + m2l.Cj.size();  //  Accumulate M2L cell pairs
+      for (int k=0; k<int(m2l.Cj.size()); k++) {                //  Loop over M2L sources
+        appendPlan(Ci0+i, m2l.Cj[k], m2l.Xperiodic[k], cycle);  //   Append M2L source to plan
+      }                                                         //  End loop over M2L sources
+      p2p.Cj.clear();                                           //  Empty P2P list but keep its memory
+      p2p.Xperiodic.clear();                                    //  Empty offsets but keep their memory
+      plan->offset[i+1] = plan->source.size();                  //  Offset of next target cell
+    }                                                           // End loop over target cells
+  }
+
+  //! Recursive functor for replaying a plan for a range of target cells
+  struct PlanRange {
+    Traversal * traversal;                                      //!< Traversal object
+    const Plan * plan;                                          //!< Recorded plan
+    real_t cycle;                                               //!< Periodic cycle
+    int begin;                                                  //!< Index of first target cell
+    int end;                                                    //!< Index of last target cell + 1
+    PlanRange(Traversal * _traversal, const Plan * _plan, real_t _cycle, int _begin, int _end) :// Constructor
+      traversal(_traversal), plan(_plan), cycle(_cycle), begin(_begin), end(_end) {}// Initialize variables
+    //! Estimated cycles of the target cells before cell i
+    double prefixCost(int i) {
+      return plan->pairsP2P[i] * traversal->costP2P + plan->pairsM2L[i] * traversal->costM2L;
+    }
+    void operator() () {                                        // Overload operator()
+      const std::vector<int> & offset = plan->offset;           //  Offsets of sources
+      double cost = prefixCost(end) - prefixCost(begin);        //  Estimated cycles of range
+      if (end - begin == 1 || cost < traversal->spawnCost) {    //  If range is small enough
+        std::vector<C_iter> Cj;                                 //   M2L sources of one target cell
+        std::vector<vec3> Xperiodic;                            //   Periodic offsets of M2L sources
+        bool periodic = !plan->image.empty();                   //   Flag for periodic images
+	for (int i=begin; i<end; i++) {                         //   Loop over target cells
+	  C_iter Ci = traversal->Ci0 + i;                       //    Target cell
+	  int k = offset[i];                                    //    Index of first source
+	  int numSources = 0;                                   //    Number of P2P source bodies
+	  uint64_t tic = traversal->startCount();               //    Start cycle counter
+	  for (; k<offset[i]+plan->numP2P[i]; k++) {            //    Loop over P2P sources
+	    int j = plan->source[k];                            //     Index of source cell
+	    if (j < 0) {                                        //     If source and target are same
+	      kernel::P2P(Ci, traversal->eps2);                 //      P2P kernel for single cell
+	      numSources += Ci->NBODY;                          //      Count source bodies
+	    } else {                                            //     Else if source and target are different
+	      vec3 X = periodic ? getXperiodic(plan->image[k], cycle) : vec3(0);// Periodic offset
+	      traversal->kernelP2P[0](Ci, traversal->Cj0+j, traversal->eps2, X);// P2P kernel for pair of cells
+	      numSources += (traversal->Cj0+j)->NBODY;          //      Count source bodies
+	    }                                                   //     End if for same source and target
+	  }                                                     //    End loop over P2P sources
+	  traversal->countP2P(double(Ci->NBODY) * numSources, tic);// Count P2P body pairs
+	  Cj.clear();                                           //    Clear M2L sources
+	  Xperiodic.clear();                                    //    Clear periodic offsets
+	  for (; k<offset[i+1]; k++) {                          //    Loop over M2L sources
+	    Cj.push_back(traversal->Cj0 + plan->source[k]);     //     Append source cell
+	    Xperiodic.push_back(periodic ? getXperiodic(plan->image[k], cycle) : vec3(0));// Append periodic offset
+	  }                                                     //    End loop over M2L sources
+	  tic = traversal->startCount();                        //    Start cycle counter
+	  if (!Cj.empty()) kernel::M2L(Ci, &Cj[0], &Xperiodic[0], Cj.size());// Batched M2L kernel
+	  traversal->countM2L(Cj.size(), tic);                  //    Count M2L cell pairs
+	  ThreadStats & stats = traversal->getThreadStats();    //    Statistics of this thread
+	  stats.levelP2P[traversal->getLevelI(Ci)] += plan->numP2P[i];// Count P2P at level of target cell
+	  stats.levelM2L[traversal->getLevelI(Ci)] += Cj.size();//    Count M2L at level of target cell
+	  if (!Cj.empty()) stats.lengthM2L[getBin(Cj.size())]++;//    Count list length
+	}                                                       //   End loop over target cells
+      } else {                                                  //  If range has much work
+	double half = prefixCost(begin) + cost / 2;             //   Cost at the middle of the range
+	int low = begin + 1, high = end;                        //   Search range for the split
+	while (low < high) {                                    //   Bisection on the prefix sum of costs
+	  int mid = (low + high) / 2;                           //    Middle of search range
+	  if (prefixCost(mid) < half) low = mid + 1;            //    Split is in upper half
+	  else high = mid;                                      //    Split is in lower half
+	}                                                       //   End bisection
+	int mid = low == end ? end - 1 : low;                   //   Keep both halves non-empty
+	mk_task_group;                                          //   Initialize task group
+	PlanRange leftBranch(traversal, plan, cycle, begin, mid);//   Instantiate recursive functor
+	create_taskc(leftBranch);                               //   Create new task for left branch
+	PlanRange rightBranch(traversal, plan, cycle, mid, end);//   Instantiate recursive functor
+	rightBranch();                                          //   Use old task for right branch
+	wait_tasks;                                             //   Synchronize task group
+      }                                                         //  End if for small range
+    }                                                           // End overload operator()
+  };
+
+  //! Add the contiguous bodies [B,B+n) as one target group
+  void addGroup(B_iter B, int n) {
+    vec3 Xmin = B->X, Xmax = B->X;                              // Bounding box of the group
+    for (B_iter Bi=B; Bi!=B+n; Bi++) {                          // Loop over bodies in group
+      Xmin = min(Xmin, Bi->X);                                  //  Update minimum corner
+      Xmax = max(Xmax, Bi->X);                                  //  Update maximum corner
+    }                                                           // End loop over bodies in group
+    Cell group = Cell();                                        // New target group
+    group.ICHILD = group.NCHILD = 0;                            // Groups are leafs for the kernels
+    group.IBODY = B - Ci0->BODY;                                // Index of first body
+    group.NBODY = n;                                            // Number of bodies
+    group.BODY = B;                                             // Iterator of first body
+    group.X = (Xmax + Xmin) * .5;                               // Center of bounding box
+    group.R = std::sqrt(norm(Xmax - Xmin)) * .5;                // Radius of bounding box
+    groups.push_back(group);                                    // Append group
+    groupBox.push_back((Xmax - Xmin) * .5);                     // Append half size of bounding box
+  }
+
+  //! Split the target bodies under C into groups of at most groupSize bodies along the tree order
+  void getGroups(C_iter C, int groupSize) {
+    if (C->NBODY <= groupSize || C->NCHILD == 0) {              // If cell fits in a group or is a leaf
+      for (int i=0; i<C->NBODY; i+=groupSize) {                 //  Loop over chunks of groupSize bodies
+        addGroup(C->BODY+i, std::min(groupSize, C->NBODY-i));   //   Add chunk as a new group
+      }                                                         //  End loop over chunks
+    } else {                                                    // Else if cell is too large
+      B_iter B = C->BODY;                                       //  First body of pending small siblings
+      int n = 0;                                                //  Number of bodies of pending small siblings
+      for (C_iter Cc=Ci0+C->ICHILD; Cc!=Ci0+C->ICHILD+C->NCHILD; Cc++) {// Loop over child cells
+        bool isAdjacent = Cc->BODY == B + n || Cc->BODY + Cc->NBODY == B;// Child bodies continue the pending run
+        if (n > 0 && (n + Cc->NBODY > groupSize || !isAdjacent)) {// If child doesn't fit with pending siblings
+          addGroup(B, n);                                       //    Flush pending siblings into one group
+          n = 0;                                                //    No pending siblings
+        }                                                       //   End if for full group
+        if (Cc->NBODY > groupSize) {                            //   If child is too large itself
+          getGroups(Cc, groupSize);                             //    Recurse into child
+        } else {                                                //   Else if child fits in a group
+          if (n == 0 || Cc->BODY < B) B = Cc->BODY;             //    First body of the run
+          n += Cc->NBODY;                                       //    Append child to pending siblings
+        }                                                       //   End if for large child
+      }                                                         //  End loop over child cells
+      if (n > 0) addGroup(B, n);                                //  Flush remaining siblings
+    }                                                           // End if for small cell
+  }
+
+  //! Walk the source tree once for target group Ci with an explicit stack and collect its P2P and M2P sources
+  /*!
+    A source cell is accepted once the box of the group lies outside its radius Cj->R.
+    This is looser than the dual tree MAC Ci->R + Cj->R, where the target radius is also
+    scaled by 1/theta, so at the same theta the potential error is about 2x larger at
+    n=20k and 5x at n=100k. Lowering theta from 0.4 to 0.3 gives the dual tree error
+    (see --groupSize in args.h); adding the group radius to the MAC costs more for the same error.
+    Leafs with fewer than maxP2PSource bodies always use P2P.
+  */
+  void traverseGroup(C_iter Ci, vec3 Ri, vec3 Xperiodic, std::vector<C_iter> & stack,
+		     SourceList & p2p, SourceList & m2p) {
+    stack.push_back(Cj0);                                       // Start from source root
+    while (!stack.empty()) {                                    // While there are source cells to visit
+      C_iter Cj = stack.back();                                 //  Source cell on top of the stack
+      stack.pop_back();                                         //  Pop it
+      vec3 dX = Ci->X - Cj->X - Xperiodic;                      //  Distance vector from source center to group center
+      for (int d=0; d<3; d++) dX[d] = std::max(std::abs(dX[d]) - Ri[d], real_t(0));// Distance to group box
+      bool isFar = norm(dX) > Cj->R * Cj->R;                    //  Multipole acceptance criterion
+      bool isCheap = Cj->NCHILD == 0 && Cj->NBODY < maxP2PSource;//  P2P is cheaper than M2P
+      if (isFar && !isCheap) {                                  //  If source cell is far enough
+	m2p.Cj.push_back(Cj);                                   //   Append M2P source
+	m2p.Xperiodic.push_back(Xperiodic);                     //   Append periodic offset
+      } else if (Cj->NCHILD == 0) {                             //  Else if source cell is a leaf
+	p2p.Cj.push_back(Cj);                                   //   Append P2P source
+	p2p.Xperiodic.push_back(Xperiodic);                     //   Append periodic offset
+      } else {                                                  //  Else if source cell must be split
+	for (C_iter cj=Cj0+Cj->ICHILD; cj!=Cj0+Cj->ICHILD+Cj->NCHILD; cj++) {// Loop over children
+	  stack.push_back(cj);                                  //    Push child
+	}                                                       //   End loop over children
+      }                                                         //  End if for MAC
+    }                                                           // End while loop for source cells
+  }
+
+  //! Recursive functor for the group traversal of a range of target groups
+  struct GroupRange {
+    Traversal * traversal;                                      //!< Traversal object
+    real_t cycle;                                               //!< Periodic cycle
+    int begin;                                                  //!< Index of first target group
+    int end;                                                    //!< Index of last target group + 1
+    GroupRange(Traversal * _traversal, real_t _cycle, int _begin, int _end) :// Constructor
+      traversal(_traversal), cycle(_cycle), begin(_begin), end(_end) {}// Initialize variables
+    void operator() () {                                        // Overload operator()
+      C_iter G0 = traversal->groups.begin();                    //  Iterator of first target group
+      int work = (G0+end-1)->IBODY + (G0+end-1)->NBODY - (G0+begin)->IBODY;// Number of target bodies in range
+      if (end - begin == 1 || work < traversal->nspawn) {       //  If range is small enough
+	std::vector<C_iter> stack;                              //   Stack of source cells to visit
+	SourceList p2p, m2p;                                    //   P2P and M2P sources of one target group
+	int prange = traversal->images == 0 ? 0 : 1;            //   Range of periodic images walked explicitly
+	for (int i=begin; i<end; i++) {                         //   Loop over target groups
+	  C_iter Ci = G0 + i;                                   //    Target group
+	  vec3 Ri = traversal->groupBox[i];                     //    Half size of target group
+	  p2p.Cj.clear(), p2p.Xperiodic.clear();                //    Clear P2P sources
+	  m2p.Cj.clear(), m2p.Xperiodic.clear();                //    Clear M2P sources
+	  vec3 Xperiodic = 0;                                   //    Periodic coordinate offset
+	  for (int ix=-prange; ix<=prange; ix++) {              //    Loop over x periodic direction
+	    for (int iy=-prange; iy<=prange; iy++) {            //     Loop over y periodic direction
+	      for (int iz=-prange; iz<=prange; iz++) {          //      Loop over z periodic direction
+		Xperiodic[0] = ix * cycle;                      //       Coordinate shift for x periodic direction
+		Xperiodic[1] = iy * cycle;                      //       Coordinate shift for y periodic direction
+		Xperiodic[2] = iz * cycle;                      //       Coordinate shift for z periodic direction
+		traversal->traverseGroup(Ci, Ri, Xperiodic, stack, p2p, m2p);// Walk the source tree
+	      }                                                 //      End loop over z periodic direction
+	    }                                                   //     End loop over y periodic direction
+	  }                                                     //    End loop over x periodic direction
+	  int numSources = 0;                                   //    Number of P2P source bodies
+	  uint64_t tic = traversal->startCount();               //    Start cycle counter
+	  for (size_t j=0; j<p2p.Cj.size(); j++) {              //    Loop over P2P sources
+	    traversal->kernelP2P[0](Ci, p2p.Cj[j], traversal->eps2, p2p.Xperiodic[j]);// P2P kernel over the group
+	    numSources += p2p.Cj[j]->NBODY;                     //     Count source bodies
+	  }                                                     //    End loop over P2P sources
+	  traversal->countP2P(double(Ci->NBODY) * numSources, tic);// Count P2P body pairs
+	  tic = traversal->startCount();                        //    Start cycle counter
+	  for (size_t j=0; j<m2p.Cj.size(); j++) {              //    Loop over M2P sources
+	    kernel::M2P(Ci, m2p.Cj[j], m2p.Xperiodic[j]);       //     M2P kernel over the group
+	  }                                                     //    End loop over M2P sources
+	  traversal->countM2P(m2p.Cj.size(), tic);              //    Count M2P calls
+	  if (!m2p.Cj.empty()) traversal->getThreadStats().lengthM2P[getBin(m2p.Cj.size())]++;// Count M2P list length
+	}                                                       //   End loop over target groups
+      } else {                                                  //  If range has much work
+	int mid = (begin + end) / 2;                            //   Split range into halves
+	mk_task_group;                                          //   Initialize task group
+	GroupRange leftBranch(traversal, cycle, begin, mid);    //   Instantiate recursive functor
+	create_taskc(leftBranch);                               //   Create new task for left branch
+	GroupRange rightBranch(traversal, cycle, mid, end);     //   Instantiate recursive functor
+	rightBranch();                                          //   Use old task for right branch
+	wait_tasks;                                             //   Synchronize task group
+      }                                                         //  End if for small range
+    }                                                           // End overload operator()
+  };
+
+  //! M2L from the periodic images of source root Cj to target root Ci, one image sublevel at a time
+  void periodicM2L(C_iter Ci, C_iter Cj, real_t cycle) {
     vec3 Xperiodic = 0;                                         // Periodic coordinate offset
     Cells pcells; pcells.resize(27);                            // Create cells
-    C_iter Ci = pcells.end()-1;                                 // Last cell is periodic parent cell
-    *Ci = *Cj0;                                                 // Copy values from source root
-    Ci->ICHILD = 0;                                             // Child cells for periodic center cell
-    Ci->NCHILD = 26;                                            // Number of child cells for periodic center cell
-    C_iter C0 = Cj0;                                            // Placeholder for Cj0
+    C_iter Cp = pcells.end()-1;                                 // Last cell is periodic parent cell
+    *Cp = *Cj;                                                  // Copy values from source root
+    Cp->ORDER = P;                                              // Periodic images always use full order
+    Cp->ICHILD = 0;                                             // Child cells for periodic center cell
+    Cp->NCHILD = 26;                                            // Number of child cells for periodic center cell
     for (int level=0; level<images-1; level++) {                // Loop over sublevels of tree
       for (int ix=-1; ix<=1; ix++) {                            //  Loop over x periodic direction
         for (int iy=-1; iy<=1; iy++) {                          //   Loop over y periodic direction
@@ -144,7 +866,7 @@ private:
                     Xperiodic[0] = (ix * 3 + cx) * cycle;       //         Coordinate offset for x periodic direction
                     Xperiodic[1] = (iy * 3 + cy) * cycle;       //         Coordinate offset for y periodic direction
                     Xperiodic[2] = (iz * 3 + cz) * cycle;       //         Coordinate offset for z periodic direction
-		    kernel::M2L(Ci0, Ci, Xperiodic, false);     //         M2L kernel
+		    kernel::M2L(Ci, Cp, Xperiodic, false);      //         M2L kernel
                   }                                             //        End loop over z periodic direction (child)
                 }                                               //       End loop over y periodic direction (child)
               }                                                 //      End loop over x periodic direction (child)
@@ -153,34 +875,86 @@ private:
         }                                                       //   End loop over y periodic direction
       }                                                         //  End loop over x periodic direction
 #if MASS
-      for (int i=1; i<NTERM; i++) Ci->M[i] *= Ci->M[0];         //  Normalize multipole expansion coefficients
+      for (int i=1; i<NTERM; i++) Cp->M[i] *= Cp->M[0];         //  Normalize multipole expansion coefficients
 #endif
-      Cj0 = pcells.begin();                                     //  Redefine Cj0 for M2M
-      C_iter Cj = Cj0;                                          //  Iterator of periodic neighbor cells
+      C_iter C = pcells.begin();                                //  Iterator of periodic neighbor cells
       for (int ix=-1; ix<=1; ix++) {                            //  Loop over x periodic direction
         for (int iy=-1; iy<=1; iy++) {                          //   Loop over y periodic direction
           for (int iz=-1; iz<=1; iz++) {                        //    Loop over z periodic direction
             if (ix != 0 || iy != 0 || iz != 0) {                //     If periodic cell is not at center
-              Cj->X[0] = Ci->X[0] + ix * cycle;                 //      Set new x coordinate for periodic image
-              Cj->X[1] = Ci->X[1] + iy * cycle;                 //      Set new y cooridnate for periodic image
-              Cj->X[2] = Ci->X[2] + iz * cycle;                 //      Set new z coordinate for periodic image
-              Cj->M    = Ci->M;                                 //      Copy multipoles to new periodic image
-              Cj++;                                             //      Increment periodic cell iterator
+              C->X[0] = Cp->X[0] + ix * cycle;                  //      Set new x coordinate for periodic image
+              C->X[1] = Cp->X[1] + iy * cycle;                  //      Set new y cooridnate for periodic image
+              C->X[2] = Cp->X[2] + iz * cycle;                  //      Set new z coordinate for periodic image
+              C->M    = Cp->M;                                  //      Copy multipoles to new periodic image
+              C++;                                              //      Increment periodic cell iterator
             }                                                   //     Endif for periodic center cell
           }                                                     //    End loop over z periodic direction
         }                                                       //   End loop over y periodic direction
       }                                                         //  End loop over x periodic direction
-      Ci->M = 0;                                                //  Reset multipoles of periodic parent
-      kernel::M2M(Ci,Cj0);                                      //  Evaluate periodic M2M kernels for this sublevel
+      Cp->M = 0;                                                //  Reset multipoles of periodic parent
+      kernel::M2M(Cp, pcells.begin());                          //  Evaluate periodic M2M kernels for this sublevel
 #if MASS
-      for (int i=1; i<NTERM; i++) Ci->M[i] /= Ci->M[0];         //  Normalize multipole expansion coefficients
+      for (int i=1; i<NTERM; i++) Cp->M[i] /= Cp->M[0];         //  Normalize multipole expansion coefficients
 #endif
       cycle *= 3;                                               //  Increase center cell size three times
-      Cj0 = C0;                                                 //  Reset Cj0 back
     }                                                           // End loop over sublevels of tree
 #if MASS
-    Ci0->L /= Ci0->M[0];                                        // Normalize local expansion coefficients
+    Ci->L /= Ci->M[0];                                          // Normalize local expansion coefficients
 #endif
+  }
+
+  //! Build the matrix of periodicM2L() by applying it to unit multipole expansions
+  void buildPeriodicOperator(real_t cycle) {
+    const int n = sizeof(vecP) / sizeof(ereal_t);               // Real numbers in an expansion
+    const int n0 = n / NTERM;                                   // Real numbers per coefficient
+    Cells cells(2);                                             // Target and source root of the probes
+    C_iter Ci = cells.begin(), Cj = cells.begin() + 1;          // Iterators of probe roots
+    *Ci = *Ci0;                                                 // Copy geometry of target root
+    *Cj = *Cj0;                                                 // Copy geometry of source root
+    std::vector<ereal_t> & T = periodicOperator.T;              // Operator matrix
+    T.assign(n * n, 0);                                         // Initialize operator matrix
+    for (int k=0; k<n; k++) {                                   // Loop over real numbers of the multipole expansion
+      if (0 < k && k < n0) continue;                            //  M[0] is real
+      Ci->M = 0;                                                //  Unit mass at target root (cancelled by MASS normalization)
+      Ci->M[0] = 1;                                             //  Unit monopole
+      Ci->L = 0;                                                //  Initialize local expansion
+      Cj->M = 0;                                                //  Probe is the unit monopole ...
+      Cj->M[0] = 1;                                             //  ... which keeps it normalized under MASS
+      if (k > 0) reinterpret_cast<ereal_t*>(&Cj->M[0])[k] += 1; //  ... plus the k-th unit vector
+      periodicM2L(Ci, Cj, cycle);                               //  Apply periodic M2L to the probe
+      const ereal_t * L = reinterpret_cast<const ereal_t*>(&Ci->L[0]);// Response to the probe
+      for (int i=0; i<n; i++) {                                 //  Loop over real numbers of the local expansion
+        T[i*n+k] = L[i] - (k > 0 ? T[i*n] : 0);                 //   Subtract response to the unit monopole
+      }                                                         //  End loop over real numbers of the local expansion
+    }                                                           // End loop over real numbers of the multipole expansion
+  }
+
+  //! Tree traversal of periodic cells
+  void traversePeriodic(real_t cycle) {
+    logger::startTimer("Traverse periodic");                    // Start timer
+    vec3 dX = Ci0->X - Cj0->X;                                  // Distance between target and source root
+    if (periodicOperator.cycle != cycle || norm(periodicOperator.dX - dX) != 0) {// If lattice changed
+      periodicOperator.cycle = cycle;                           //  Remember periodic cycle
+      periodicOperator.dX = dX;                                 //  Remember distance between roots
+      periodicOperator.T.clear();                               //  Discard operator of old lattice
+      periodicM2L(Ci0, Cj0, cycle);                             //  Evaluate images directly until the lattice is reused
+    } else {                                                    // Else if lattice was used before
+      if (periodicOperator.T.empty()) buildPeriodicOperator(cycle);//  Build and cache the periodic operator
+      const int n = sizeof(vecP) / sizeof(ereal_t);             //  Real numbers in an expansion
+      const std::vector<ereal_t> & T = periodicOperator.T;      //  Operator matrix
+      vecP M = Cj0->M;                                          //  Multipole expansion of source root
+#if MASS
+      for (int i=1; i<NTERM; i++) M[i] *= M[0];                 //  Undo normalization of multipole coefficients
+      Ci0->L /= Ci0->M[0];                                      //  Normalize local expansion coefficients
+#endif
+      const ereal_t * m = reinterpret_cast<const ereal_t*>(&M[0]);// Real numbers of the multipole expansion
+      ereal_t * L = reinterpret_cast<ereal_t*>(&Ci0->L[0]);     //  Real numbers of the local expansion
+      for (int i=0; i<n; i++) {                                 //  Loop over real numbers of the local expansion
+        ereal_t sum = 0;                                        //   Initialize row sum
+        for (int k=0; k<n; k++) sum += T[i*n+k] * m[k];         //   Row of matrix-vector product
+        L[i] += sum;                                            //   Add periodic far field
+      }                                                         //  End loop over real numbers of the local expansion
+    }                                                           // End if for lattice
     logger::stopTimer("Traverse periodic");                     // Stop timer
   }
 
@@ -189,11 +963,13 @@ private:
     if (Cj->NCHILD == 0) {                                      // If Cj is leaf
       assert(Ci->NCHILD > 0);                                   //  Make sure Ci is not leaf
       for (C_iter ci=Ci0+Ci->ICHILD; ci!=Ci0+Ci->ICHILD+Ci->NCHILD; ci++) {// Loop over Ci's children
+        if (ci+1 != Ci0+Ci->ICHILD+Ci->NCHILD) prefetchFar(ci+1, Cj, Xperiodic, mutual);// Prefetch next pair
         traverse(ci, Cj, Xperiodic, mutual, remote);            //   Traverse a single pair of cells
       }                                                         //  End loop over Ci's children
     } else if (Ci->NCHILD == 0) {                               // Else if Ci is leaf
       assert(Cj->NCHILD > 0);                                   //  Make sure Cj is not leaf
       for (C_iter cj=Cj0+Cj->ICHILD; cj!=Cj0+Cj->ICHILD+Cj->NCHILD; cj++) {// Loop over Cj's children
+        if (cj+1 != Cj0+Cj->ICHILD+Cj->NCHILD) prefetchFar(Ci, cj+1, Xperiodic, mutual);// Prefetch next pair
         traverse(Ci, cj, Xperiodic, mutual, remote);            //   Traverse a single pair of cells
       }                                                         //  End loop over Cj's children
     } else if (Ci->NBODY + Cj->NBODY >= nspawn || (mutual && Ci == Cj)) {// Else if cells are still large
@@ -202,10 +978,12 @@ private:
       traverseRange();                                          //  Traverse for range of cell pairs
     } else if (Ci->R >= Cj->R) {                                // Else if Ci is larger than Cj
       for (C_iter ci=Ci0+Ci->ICHILD; ci!=Ci0+Ci->ICHILD+Ci->NCHILD; ci++) {// Loop over Ci's children
+        if (ci+1 != Ci0+Ci->ICHILD+Ci->NCHILD) prefetchFar(ci+1, Cj, Xperiodic, mutual);// Prefetch next pair
         traverse(ci, Cj, Xperiodic, mutual, remote);            //   Traverse a single pair of cells
       }                                                         //  End loop over Ci's children
     } else {                                                    // Else if Cj is larger than Ci
       for (C_iter cj=Cj0+Cj->ICHILD; cj!=Cj0+Cj->ICHILD+Cj->NCHILD; cj++) {// Loop over Cj's children
+        if (cj+1 != Cj0+Cj->ICHILD+Cj->NCHILD) prefetchFar(Ci, cj+1, Xperiodic, mutual);// Prefetch next pair
         traverse(Ci, cj, Xperiodic, mutual, remote);            //   Traverse a single pair of cells
       }                                                         //  End loop over Cj's children
     }                                                           // End if for leafs and Ci Cj size
@@ -213,12 +991,14 @@ private:
 
 public:
   //! Constructor
-  Traversal(int _nspawn, int _images, real_t _eps2) :           // Constructor
-    nspawn(_nspawn), images(_images), eps2(_eps2)               // Initialize variables
-#if COUNT
-    , numP2P(0), numM2L(0)
-#endif
-  {}
+  Traversal(int _nspawn, int _images, real_t _eps2, int _listM2L=0) :// Constructor
+    nspawn(_nspawn), images(_images), eps2(_eps2), listM2L(_listM2L), plan(NULL),// Initialize variables
+    threadStats(maxThreads), cyclesTraverse(0), numP2PBody(-1), numM2LBody(-1), spawnCost(0) {
+    periodicOperator.cycle = 0;                                 // No periodic operator yet
+    for (int m=0; m<2; m++) kernelP2P[m] = kernel::P2PVariant(eps2 != 0, images != 0, m);// Pick P2P kernels once
+    calibrate();                                                // Seed cost model with measured kernel costs
+    setFarCost();                                               // Far field kernel choice doesn't depend on timings
+  }
 
 #if USE_WEIGHT
   //! Initialize interaction weights of bodies and cells
@@ -241,8 +1021,33 @@ public:
     if (icells.empty() || jcells.empty()) return;               // Quit if either of the cell vectors are empty
     logger::startTimer("Traverse");                             // Start timer
     logger::initTracer();                                       // Initialize tracer
+    uint64_t tic = logger::get_cycle();                         // Start cycle counter
+    ThreadStats before = sumThreadStats();                      // Statistics before traversal
+    std::vector<uint64_t> countersBefore;                       // PAPI counters before traversal
+    logger::readPAPI(countersBefore);                           // Read PAPI counters
     Ci0 = icells.begin();                                       // Set iterator of target root cell
     Cj0 = jcells.begin();                                       // Set iterator of source root cell
+    if (&icells != &jcells) getLevels(jcells, jlevels);         // Levels of source cells
+    getLevels(icells, ilevels);                                 // Levels of target cells
+    lengths.assign(icells.size(), 0);                           // No far field sources yet
+    if (numP2PBody < 0) {                                       // If no traversal has been measured yet
+      int numLeafs = 0;                                         //  Initialize leaf counter
+      for (C_iter C=icells.begin(); C!=icells.end(); C++) numLeafs += C->NCHILD == 0;// Count target leafs
+      double leafSize = std::max(double(Ci0->NBODY) / numLeafs, 1.0);// Average bodies per leaf
+      numP2PBody = 27 * leafSize;                               //  Bodies in the neighbor leafs
+      numM2LBody = 216 / leafSize;                              //  189 M2L per cell and 8/7 cells per leaf
+    }                                                           // End if for measured traversal
+    spawnCost = nspawn * (numP2PBody * costP2P + numM2LBody * costM2L);// Cost of nspawn average bodies
+#if USE_SOA
+    isoa.scatter(icells);                                       // Copy target bodies to SoA streams
+    if (&icells != &jcells) jsoa.scatter(jcells);               // Copy source bodies to SoA streams
+#endif
+#if CHECK_RACE
+    iwriters.assign(icells.size(), 0);                          // No task writes target cells yet
+    if (&icells != &jcells) jwriters.assign(jcells.size(), 0);  // No task writes source cells yet
+#endif
+    if (listM2L || plan) lists.resize(icells.size());           // One M2L list per target cell
+    if (plan) p2pLists.resize(icells.size());                   // One P2P list per target cell
     vec3 Xperiodic = 0;                                         // Periodic coordinate offset
     if (images == 0) {                                          // If non-periodic boundary condition
       traverse(Ci0, Cj0, Xperiodic, mutual, remote);            //  Traverse the tree
@@ -259,73 +1064,268 @@ public:
       }                                                         //  End loop over x periodic direction
       traversePeriodic(cycle);                                  //  Traverse tree for periodic images
     }                                                           // End if for periodic boundary condition
+    if (plan) savePlan(cycle);                                  // Copy recorded lists into plan
+    if (listM2L || plan) evalM2L();                             // Evaluate recorded M2L lists
+    ThreadStats & stats = getThreadStats();                     // Statistics of this thread
+    for (int i=0; i<int(lengths.size()); i++) {                 // Loop over target cells
+      if (lengths[i] > 0) stats.lengthM2L[getBin(lengths[i])]++;//  Count list length
+    }                                                           // End loop over target cells
+#if USE_SOA
+    isoa.gather(icells);                                        // Add SoA targets back to target bodies
+    if (mutual && &icells != &jcells) jsoa.gather(jcells);      // Add SoA targets back to source bodies
+#endif
+    cyclesTraverse += logger::get_cycle() - tic;                // Accumulate wall clock cycles
+    std::vector<uint64_t> countersAfter;                        // PAPI counters after traversal
+    logger::readPAPI(countersAfter);                            // Read PAPI counters
+    countersTraverse.resize(countersAfter.size());              // One accumulator per PAPI event
+    for (int i=0; i<int(countersAfter.size()); i++) {           // Loop over PAPI events
+      countersTraverse[i] += countersAfter[i] - countersBefore[i];// Accumulate counts of this traversal
+    }                                                           // End loop over PAPI events
+    ThreadStats after = sumThreadStats();                       // Statistics after traversal
+    double numP2PPairs = after.numP2P - before.numP2P;          // P2P body pairs of this traversal
+    double numM2LPairs = after.numM2L - before.numM2L;          // M2L cell pairs of this traversal
+    double numTargets = double(Ci0->NBODY) * (images == 0 ? 1 : 27);// Target bodies of all periodic images
+#if COUNT
+    if (numP2PPairs > 0) costP2P = (after.cyclesP2P - before.cyclesP2P) / numP2PPairs;// Update P2P cost
+    if (numM2LPairs > 0) costM2L = (after.cyclesM2L - before.cyclesM2L) / numM2LPairs;// Update M2L cost
+#endif
+    if (numTargets > 0) {                                       // If there are target bodies
+      numP2PBody = numP2PPairs / numTargets;                    //  Update P2P body pairs per target body
+      numM2LBody = numM2LPairs / numTargets;                    //  Update M2L cell pairs per target body
+    }                                                           // End if for target bodies
     logger::stopTimer("Traverse");                              // Stop timer
     logger::writeTracer();                                      // Write tracer to file
   }
 
-  struct DirectRecursion {
-    C_iter Ci;                                                  //!< Iterator of target cell
-    C_iter Cj;                                                  //!< Iterator of source cell
-    real_t eps2;                                                //!< Softening parameter (squared)
-    int prange;                                                 //!< Range of periodic images
-    real_t cycle;                                               //!< Periodic cycle
-    DirectRecursion(C_iter _Ci, C_iter _Cj, real_t _eps2, int _prange, real_t _cycle) :// Constructor
-      Ci(_Ci), Cj(_Cj), eps2(_eps2), prange(_prange), cycle(_cycle) {} // Initialize variables
+  //! Evaluate P2P and M2L using dual tree traversal and record them in a plan for replayPlan()
+  void recordPlan(Plan & _plan, Cells & icells, Cells & jcells, real_t cycle, bool mutual, real_t remote=1) {
+    assert(!mutual || &icells == &jcells);                      // Mutual pairs between different cells can't be replayed
+    plan = &_plan;                                              // Record into this plan
+    dualTreeTraversal(icells, jcells, cycle, mutual, remote);   // Traverse and evaluate the tree
+    plan = NULL;                                                // Stop recording
+  }
+
+  //! Evaluate P2P and M2L from a recorded plan without traversing the tree (geometry must be unchanged)
+  void replayPlan(const Plan & _plan, Cells & icells, Cells & jcells, real_t cycle) {
+    if (icells.empty() || jcells.empty()) return;               // Quit if either of the cell vectors are empty
+    assert(_plan.offset.size() == icells.size()+1);             // Check if plan was recorded for these cells
+    logger::startTimer("Traverse");                             // Start timer
+    uint64_t tic = logger::get_cycle();                         // Start cycle counter
+    Ci0 = icells.begin();                                       // Set iterator of target root cell
+    Cj0 = jcells.begin();                                       // Set iterator of source root cell
+    getLevels(icells, ilevels);                                 // Levels of target cells
+#if USE_SOA
+    isoa.scatter(icells);                                       // Copy target bodies to SoA streams
+    if (&icells != &jcells) jsoa.scatter(jcells);               // Copy source bodies to SoA streams
+#endif
+    PlanRange planRange(this, &_plan, cycle, 0, icells.size()); // Instantiate recursive functor
+    planRange();                                                // Replay interactions of all target cells
+    if (images != 0) traversePeriodic(cycle);                   // Traverse tree for periodic images
+#if USE_SOA
+    isoa.gather(icells);                                        // Add SoA targets back to target bodies
+#endif
+    cyclesTraverse += logger::get_cycle() - tic;                // Accumulate wall clock cycles
+    logger::stopTimer("Traverse");                              // Stop timer
+  }
+
+  //! Evaluate P2P and M2P by walking the source tree once per group of target bodies (no M2L)
+  void groupTraversal(Cells & icells, Cells & jcells, real_t cycle, int groupSize) {
+    if (icells.empty() || jcells.empty()) return;               // Quit if either of the cell vectors are empty
+    logger::startTimer("Traverse");                             // Start timer
+    uint64_t tic = logger::get_cycle();                         // Start cycle counter
+    Ci0 = icells.begin();                                       // Set iterator of target root cell
+    Cj0 = jcells.begin();                                       // Set iterator of source root cell
+    groupSize = (groupSize + NSIMD - 1) / NSIMD * NSIMD;        // Align group size to SIMD width
+    groups.clear();                                             // Clear target groups
+    groupBox.clear();                                           // Clear bounding boxes of target groups
+    getGroups(Ci0, groupSize);                                  // Group target bodies
+#if USE_SOA
+    gsoa.scatter(groups);                                       // Copy target groups to SoA streams
+    jsoa.scatter(jcells);                                       // Copy source bodies to SoA streams
+#endif
+    GroupRange groupRange(this, cycle, 0, groups.size());       // Instantiate recursive functor
+    groupRange();                                               // Traverse for all target groups
+    if (images != 0) traversePeriodic(cycle);                   // Traverse tree for periodic images
+#if USE_SOA
+    gsoa.gather(groups);                                        // Add SoA targets back to target bodies
+#endif
+    cyclesTraverse += logger::get_cycle() - tic;                // Accumulate wall clock cycles
+    logger::stopTimer("Traverse");                              // Stop timer
+  }
+
+  //! Recursive functor for direct summation of a range of target bodies, tile by tile over cache sized source blocks
+  struct DirectTile {
+    Traversal * traversal;                                      //!< Traversal object
+    C_iter Ci;                                                  //!< Iterator of target tile
+    Cells * blocks;                                             //!< Source blocks
+    int numSources;                                             //!< Number of source bodies
+    DirectTile(Traversal * _traversal, C_iter _Ci, Cells * _blocks, int _numSources) :// Constructor
+      traversal(_traversal), Ci(_Ci), blocks(_blocks), numSources(_numSources) {}// Initialize variables
     void operator() () {                                        // Overload operator
-      if (Ci->NBODY < 25) {                                     // If number of target bodies is less than threshold
-	vec3 Xperiodic = 0;                                     //   Periodic coordinate offset
-	for (int ix=-prange; ix<=prange; ix++) {                //   Loop over x periodic direction
-	  for (int iy=-prange; iy<=prange; iy++) {              //    Loop over y periodic direction
-	    for (int iz=-prange; iz<=prange; iz++) {            //     Loop over z periodic direction
-	      Xperiodic[0] = ix * cycle;                        //      Coordinate shift for x periodic direction
-	      Xperiodic[1] = iy * cycle;                        //      Coordinate shift for y periodic direction
-	      Xperiodic[2] = iz * cycle;                        //      Coordinate shift for z periodic direction
-	      kernel::P2P(Ci, Cj, eps2, Xperiodic, false);      //      Evaluate P2P kernel
-	    }                                                   //     End loop over z periodic direction
-	  }                                                     //    End loop over y periodic direction
-	}                                                       //   End loop over x periodic direction
-      } else {                                                  // If number of target bodies is more than threshold
+      double work = double(Ci->NBODY) * numSources;             // Body pairs of this tile
+      double spawn = double(traversal->nspawn) * traversal->nspawn;// Body pairs worth a task
+      if (Ci->NBODY <= NSIMD || (Ci->NBODY <= directTileSize && work <= spawn)) {// If tile is small enough
+	for (C_iter Cj=blocks->begin(); Cj!=blocks->end(); Cj++) {// Loop over source blocks
+	  kernel::P2P(Ci, Cj, traversal->eps2, vec3(0), false); //    Evaluate P2P kernel
+	}                                                       //   End loop over source blocks
+      } else {                                                  // If tile is still large
         Cells cells; cells.resize(1);                           //  Initialize new cell vector
 	C_iter Ci2 = cells.begin();                             //  New cell iterator for right branch
-	Ci2->BODY = Ci->BODY + Ci->NBODY / 2;                   //  Set begin iterator to handle latter half
-	Ci2->NBODY = Ci->NBODY - Ci->NBODY / 2;                 //  Set range to handle latter half
-	Ci->NBODY = Ci->NBODY / 2;                              //  Set range to handle first half
+	int nhalf = (Ci->NBODY / 2 + NSIMD - 1) / NSIMD * NSIMD;//  Number of bodies in first half (SIMD aligned)
+#if USE_SOA
+	Ci2->SOA = Ci->SOA;                                     //  Share streams with first half
+	Ci2->ISOA = Ci->ISOA + nhalf;                           //  Index of second half in streams
+#endif
+	Ci2->BODY = Ci->BODY + nhalf;                           //  Set begin iterator to handle latter half
+	Ci2->NBODY = Ci->NBODY - nhalf;                         //  Set range to handle latter half
+	Ci->NBODY = nhalf;                                      //  Set range to handle first half
 	mk_task_group;                                          //  Initialize task group
-        DirectRecursion leftBranch(Ci, Cj, eps2, prange, cycle);//  Instantiate recursive functor
+        DirectTile leftBranch(traversal, Ci, blocks, numSources);//  Instantiate recursive functor
 	create_taskc(leftBranch);                               //  Create new task for left branch
-	DirectRecursion rightBranch(Ci2, Cj, eps2, prange, cycle); //  Instantiate recursive functor
+	DirectTile rightBranch(traversal, Ci2, blocks, numSources);// Instantiate recursive functor
 	rightBranch();                                          //  Use old task for right branch
 	wait_tasks;                                             //  Synchronize task group
-      }                                                         // End if for NBODY threshold
+      }                                                         // End if for tile size
     }                                                           // End operator
   };
 
-  //! Direct summation
-  void direct(Bodies & ibodies, Bodies & jbodies, real_t cycle) {
-    Cells cells; cells.resize(2);                               // Define a pair of cells to pass to P2P kernel
-    C_iter Ci = cells.begin(), Cj = cells.begin()+1;            // First cell is target, second cell is source
-    Ci->BODY = ibodies.begin();                                 // Iterator of first target body
-    Ci->NBODY = ibodies.size();                                 // Number of target bodies
-    Cj->BODY = jbodies.begin();                                 // Iterator of first source body
-    Cj->NBODY = jbodies.size();                                 // Number of source bodies
-    int prange = 0;                                             // Range of periodic images
-    for (int i=0; i<images; i++) {                              // Loop over periodic image sublevels
-      prange += int(std::pow(3.,i));                            //  Accumulate range of periodic images
-    }                                                           // End loop over perioidc image sublevels
-#if 1
-    DirectRecursion directRecursion(Ci, Cj, eps2, prange, cycle); // Instantiate recursive functor
-    directRecursion();                                          // Recursive call for direct summation
+  //! Functor for the mutual P2P of one pair of source blocks (the block itself if Ci == Cj)
+  struct DirectPair {
+    C_iter Ci;                                                  //!< Iterator of first block
+    C_iter Cj;                                                  //!< Iterator of second block
+    real_t eps2;                                                //!< Softening parameter (squared)
+    DirectPair(C_iter _Ci, C_iter _Cj, real_t _eps2) :          // Constructor
+      Ci(_Ci), Cj(_Cj), eps2(_eps2) {}                          // Initialize variables
+    void operator() () {                                        // Overload operator
+      if (Ci == Cj) kernel::P2P(Ci, eps2);                      //  P2P kernel within one block
+      else kernel::P2P(Ci, Cj, eps2, vec3(0), true);            //  Mutual P2P kernel between blocks
+    }                                                           // End operator
+  };
+
+  //! Split bodies into cache sized blocks of SIMD aligned length
+  void getBlocks(Bodies & bodies, Cells & blocks) {
+#if USE_SOA
+    int blockSize = directBlockBytes / (4 * sizeof(real_t));    // Bodies per block in SoA streams
 #else
-    for (int ix=-prange; ix<=prange; ix++) {                    // Loop over x periodic direction
-      for (int iy=-prange; iy<=prange; iy++) {                  //  Loop over y periodic direction
-	for (int iz=-prange; iz<=prange; iz++) {                //   Loop over z periodic direction
-	  Xperiodic[0] = ix * cycle;                            //    Coordinate shift for x periodic direction
-	  Xperiodic[1] = iy * cycle;                            //    Coordinate shift for y periodic direction
-	  Xperiodic[2] = iz * cycle;                            //    Coordinate shift for z periodic direction
-	  kernel::P2P(Ci, Cj, eps2, Xperiodic, false);          //    Evaluate P2P kernel
-	}                                                       //   End loop over z periodic direction
-      }                                                         //  End loop over y periodic direction
-    }                                                           // End loop over x periodic direction
+    int blockSize = directBlockBytes / sizeof(Body);            // Bodies per block
+#endif
+    blockSize = std::max(blockSize / NSIMD * NSIMD, int(NSIMD));// Keep blocks aligned to SIMD width
+    int numBlocks = (bodies.size() + blockSize - 1) / blockSize;// Number of blocks
+    blocks.resize(numBlocks);                                   // Allocate blocks
+    for (int b=0; b<numBlocks; b++) {                           // Loop over blocks
+      C_iter C = blocks.begin() + b;                            //  Iterator of block
+      C->IBODY = b * blockSize;                                 //  Index of first body
+      C->NBODY = std::min(blockSize, int(bodies.size()) - C->IBODY);//  Number of bodies
+      C->BODY = bodies.begin() + C->IBODY;                      //  Iterator of first body
+      C->NCHILD = 0;                                            //  Blocks are leafs
+#if USE_SOA
+      C->ISOA = C->IBODY;                                       //  Blocks are aligned so streams need no padding
+#endif
+    }                                                           // End loop over blocks
+  }
+
+  //! Direct summation (Ewald summation converted to the lattice of periodic images if periodic)
+  void direct(Bodies & ibodies, Bodies & jbodies, real_t cycle, bool mutual=false) {
+    if (images != 0) {                                          // If periodic boundary condition
+      Ewald ewald(11, 8 / cycle, .25 / M_PI, cycle / 2, cycle); //  Truncation errors erfc(4) and exp(-(11 pi / 8)^2) are ~1e-8
+      Bodies field = ibodies;                                   //  Ewald fields of target bodies
+      for (B_iter B=field.begin(); B!=field.end(); B++) B->TRG = 0;// Initialize fields
+      ewald.wavePart(field, jbodies);                           //  Ewald wave part
+      ewald.realPart(field, jbodies);                           //  Ewald real part of nearest images and self term
+      Bodies unit(1);                                           //  Unit charge at the origin
+      unit[0].X = 0;                                            //  Position of unit charge
+      unit[0].SRC = 1;                                          //  Charge of unit charge
+      unit[0].TRG = 0;                                          //  Initialize field of unit charge
+      ewald.wavePart(unit, unit);                               //  Ewald wave part of unit charge on itself
+      ewald.realPart(unit, unit);                               //  Ewald real part of unit charge on itself
+      int prange = 0;                                           //  Range of periodic images
+      for (int i=0; i<images; i++) {                            //  Loop over periodic image sublevels
+	prange += int(std::pow(3.,i));                          //   Accumulate range of periodic images
+      }                                                         //  End loop over periodic image sublevels
+      double lattice = 0;                                       //  Potential of the images of a unit charge
+      for (int ix=-prange; ix<=prange; ix++) {                  //  Loop over x periodic direction
+	for (int iy=-prange; iy<=prange; iy++) {                //   Loop over y periodic direction
+	  for (int iz=-prange; iz<=prange; iz++) {              //    Loop over z periodic direction
+	    if (ix != 0 || iy != 0 || iz != 0) {                //     If not the original cell
+	      lattice += 1 / (std::sqrt(double(ix * ix + iy * iy + iz * iz)) * cycle);// Accumulate image potential
+	    }                                                   //     End if for original cell
+	  }                                                     //    End loop over z periodic direction
+	}                                                       //   End loop over y periodic direction
+      }                                                         //  End loop over x periodic direction
+      double charge = 0, second = 0;                            //  Total charge and second moment of sources
+      vec3 dipole = 0;                                          //  Dipole of sources
+      for (B_iter B=jbodies.begin(); B!=jbodies.end(); B++) {   //  Loop over source bodies
+	charge += B->SRC;                                       //   Accumulate charge
+	dipole += B->X * B->SRC;                                //   Accumulate dipole
+	second += norm(B->X) * B->SRC;                          //   Accumulate second moment
+      }                                                         //  End loop over source bodies
+      double constant = charge * (lattice - unit[0].TRG[0]);    //  Offset of the image lattice from Ewald
+      double coef = 2 * M_PI / (3 * cycle * cycle * cycle);     //  Coefficient of the surface term of a cubic lattice
+      for (int b=0; b<int(ibodies.size()); b++) {               //  Loop over target bodies
+	vec3 X = ibodies[b].X;                                  //   Position of target
+	double MX = 0;                                          //   Dipole times position
+	for (int d=0; d<3; d++) MX += dipole[d] * X[d];         //   Dot product
+	field[b].TRG[0] += constant - coef * (charge * norm(X) - 2 * MX + second);// Surface term for potential
+	for (int d=0; d<3; d++) {                               //   Loop over dimensions
+	  field[b].TRG[d+1] -= 2 * coef * (charge * X[d] - dipole[d]);// Surface term for forces
+	}                                                       //   End loop over dimensions
+	ibodies[b].TRG += field[b].TRG * ibodies[b].SRC;        //   Scale by target charge like the P2P kernel
+      }                                                         //  End loop over target bodies
+      return;                                                   //  No free space summation
+    }                                                           // End if for periodic boundary condition
+    Cells iblocks, jblocks;                                     // Target and source blocks
+    getBlocks(jbodies, jblocks);                                // Split sources into cache sized blocks
+#if USE_SOA
+    BodiesSoA jsoa, isoa;                                       // SoA copies of source and target bodies
+    Cells cells(1);                                             // All source bodies in one leaf for the streams
+    cells[0].NCHILD = 0;                                        // Leaf cell
+    cells[0].BODY = jbodies.begin();                            // Iterator of first source body
+    cells[0].NBODY = jbodies.size();                            // Number of source bodies
+    jsoa.scatter(cells);                                        // Copy source bodies to SoA streams
+    for (C_iter C=jblocks.begin(); C!=jblocks.end(); C++) C->SOA = &jsoa;// Link blocks to streams
+#endif
+    if (mutual && &ibodies == &jbodies) {                       // If targets are the sources and mutual is allowed
+      int numBlocks = jblocks.size();                           //  Number of blocks
+      int numSlots = numBlocks + (numBlocks & 1);               //  Round robin needs an even number of slots
+      for (int round=0; round<std::max(numSlots-1, 1); round++) {// Loop over rounds of disjoint block pairs
+	mk_task_group;                                          //   Initialize task group
+	for (int k=0; k<numSlots/2; k++) {                      //   Loop over pairs of this round
+	  int a = k == 0 ? numSlots - 1 : (round + k) % (numSlots - 1);// First slot (last slot stays fixed)
+	  int b = (round - k + numSlots - 1) % (numSlots - 1);  //    Second slot
+	  if (a < numBlocks && b < numBlocks) {                 //    If neither slot is the dummy
+	    DirectPair directPair(jblocks.begin()+a, jblocks.begin()+b, eps2);// Instantiate functor
+	    create_taskc(directPair);                           //     Create task for block pair
+	  }                                                     //    End if for dummy slot
+	}                                                       //   End loop over pairs
+	wait_tasks;                                             //   Synchronize task group
+      }                                                         //  End loop over rounds
+      mk_task_group;                                            //  Initialize task group
+      for (int a=0; a<numBlocks; a++) {                         //  Loop over blocks
+	DirectPair directPair(jblocks.begin()+a, jblocks.begin()+a, eps2);// Instantiate functor
+	create_taskc(directPair);                               //   Create task for block itself
+      }                                                         //  End loop over blocks
+      wait_tasks;                                               //  Synchronize task group
+    } else {                                                    // Else if targets are summed separately
+      Cells tiles(1);                                           //  All target bodies in one tile
+      C_iter Ci = tiles.begin();                                //  Iterator of target tile
+      Ci->NCHILD = 0;                                           //  Leaf cell
+      Ci->BODY = ibodies.begin();                               //  Iterator of first target body
+      Ci->NBODY = ibodies.size();                               //  Number of target bodies
+#if USE_SOA
+      isoa.scatter(tiles);                                      //  Copy target bodies to SoA streams
+#endif
+      DirectTile directTile(this, Ci, &jblocks, jbodies.size()); //  Instantiate recursive functor
+      directTile();                                             //  Recursive call for direct summation
+#if USE_SOA
+      Ci->NBODY = ibodies.size();                               //  Undo splitting by DirectTile
+      isoa.gather(tiles);                                       //  Add SoA targets back to bodies
+#endif
+    }                                                           // End if for mutual
+#if USE_SOA
+    if (mutual && &ibodies == &jbodies) {                       // If targets were summed in the source streams
+      cells[0].NBODY = jbodies.size();                          //  Restore source cell
+      jsoa.gather(cells);                                       //  Add SoA targets back to bodies
+    }                                                           // End if for mutual
 #endif
   }
 
@@ -336,21 +1336,141 @@ public:
     }                                                           // End loop over bodies
   }
 
+  //! Clear traversal statistics, e.g. at the start of each time step
+  void resetTraversalData() {
+    threadStats.assign(maxThreads, ThreadStats());              // Clear statistics of all threads
+    cyclesTraverse = 0;                                         // Clear wall clock cycles
+    countersTraverse.clear();                                   // Clear PAPI counters
+  }
+
   //! Print traversal statistics
   void printTraversalData() {
-#if COUNT
     if (logger::verbose) {                                      // If verbose flag is true
-      std::cout << "--- Traversal stats --------------" << std::endl// Print title
-		<< std::setw(stringLength) << std::left         //  Set format
-		<< "P2P calls"  << " : "                        //  Print title
-		<< std::setprecision(0) << std::fixed           //  Set format
-		<< numP2P << std::endl                          //  Print number of P2P calls
-		<< std::setw(stringLength) << std::left         //  Set format
-		<< "M2L calls"  << " : "                        //  Print title
-		<< std::setprecision(0) << std::fixed           //  Set format
-		<< numM2L << std::endl;                         //  Print number of M2L calls
+      ThreadStats sum = sumThreadStats();                       //  Merge statistics of all threads
+      uint64_t numP2P = 0, numM2L = 0;                          //  Cell pairs of all levels
+      for (int l=0; l<maxLevels; l++) {                         //  Loop over levels
+	numP2P += sum.levelP2P[l];                              //   Accumulate P2P cell pairs
+	numM2L += sum.levelM2L[l];                              //   Accumulate M2L cell pairs
+      }                                                         //  End loop over levels
+      logger::printTitle("Traversal stats");                    //  Print title
+      std::cout << std::setprecision(0) << std::fixed           //  Set format
+		<< std::setw(logger::stringLength) << std::left //  Set format
+		<< "P2P body pairs" << " : " << sum.numP2P << std::endl// Print number of P2P body pairs
+		<< std::setw(logger::stringLength) << std::left //  Set format
+		<< "P2P cell pairs" << " : " << numP2P << std::endl// Print number of P2P cell pairs
+		<< std::setw(logger::stringLength) << std::left //  Set format
+		<< "M2L cell pairs" << " : " << numM2L << std::endl// Print number of M2L cell pairs
+		<< std::setw(logger::stringLength) << std::left //  Set format
+		<< "M2P/P2L calls" << " : " << sum.numM2P << std::endl;// Print number of M2P and P2L calls
+      for (int l=0; l<maxLevels; l++) {                         //  Loop over levels
+	if (sum.levelP2P[l] == 0 && sum.levelM2L[l] == 0) continue;// Skip levels without interactions
+	std::stringstream name;                                 //   Name of level
+	name << "Level " << l;                                  //   Print level
+	std::cout << std::setw(logger::stringLength) << std::left// Set format
+		  << name.str() << " : P2P " << sum.levelP2P[l] //   Print P2P cell pairs of level
+		  << " M2L " << sum.levelM2L[l] << std::endl;   //   Print M2L cell pairs of level
+      }                                                         //  End loop over levels
+      logger::printMissRates(countersTraverse);                 //  Print cache miss rates of the traversal
     }                                                           // End if for verbose flag
+    printThreadData();                                          // Print thread statistics
+  }
+
+  //! Write traversal statistics and timers to traversal%06d.json and traversal%06d.csv
+  void writeTraversalData(int mpirank=0) {
+    ThreadStats sum = sumThreadStats();                         // Merge statistics of all threads
+    int numThreads = std::min(thread_count(), int(maxThreads)); // Number of threads with statistics
+    int numLevels = 0;                                          // Number of levels with interactions
+    for (int l=0; l<maxLevels; l++) {                           // Loop over levels
+      if (sum.levelP2P[l] != 0 || sum.levelM2L[l] != 0) numLevels = l + 1;// Deepest level with interactions
+    }                                                           // End loop over levels
+    std::stringstream name;                                     // File name
+    name << "traversal" << std::setfill('0') << std::setw(6) << mpirank;// Create file name for statistics
+    std::ofstream json((name.str() + ".json").c_str());         // Open JSON file
+    std::ofstream csv((name.str() + ".csv").c_str());           // Open CSV file
+    json << std::setprecision(17);                              // Keep counters exact
+    csv << std::setprecision(17);                               // Keep counters exact
+    csv << "table,index,field,value" << std::endl;              // CSV header
+    json << "{" << std::endl << "  \"totals\": {\"P2P body pairs\": " << sum.numP2P// Totals
+	 << ", \"M2L calls\": " << sum.numM2L << ", \"M2P/P2L calls\": " << sum.numM2P
+	 << ", \"tasks\": " << sum.numTasks << ", \"P2P cost\": " << costP2P
+	 << ", \"M2L cost\": " << costM2L << "}," << std::endl;
+    csv << "totals,,P2P body pairs," << sum.numP2P << std::endl // Totals
+	<< "totals,,M2L calls," << sum.numM2L << std::endl
+	<< "totals,,M2P/P2L calls," << sum.numM2P << std::endl
+	<< "totals,,tasks," << sum.numTasks << std::endl
+	<< "totals,,P2P cost," << costP2P << std::endl
+	<< "totals,,M2L cost," << costM2L << std::endl;
+    json << "  \"levels\": [";                                 // Cell pairs by level
+    for (int l=0; l<numLevels; l++) {                           // Loop over levels
+      json << (l ? ", " : "") << "{\"level\": " << l << ", \"P2P\": " << sum.levelP2P[l]
+	   << ", \"M2L\": " << sum.levelM2L[l] << "}";
+      csv << "levels," << l << ",P2P," << sum.levelP2P[l] << std::endl
+	  << "levels," << l << ",M2L," << sum.levelM2L[l] << std::endl;
+    }                                                           // End loop over levels
+    json << "]," << std::endl << "  \"M2L list lengths\": [";   // Histogram of far field list lengths
+    for (int b=0; b<maxBins; b++) {                             // Loop over bins
+      json << (b ? ", " : "") << "{\"min\": " << (1 << b) << ", \"count\": " << sum.lengthM2L[b] << "}";
+      csv << "M2L list lengths," << (1 << b) << ",count," << sum.lengthM2L[b] << std::endl;
+    }                                                           // End loop over bins
+    json << "]," << std::endl << "  \"M2P list lengths\": [";   // Histogram of group traversal M2P list lengths
+    for (int b=0; b<maxBins; b++) {                             // Loop over bins
+      json << (b ? ", " : "") << "{\"min\": " << (1 << b) << ", \"count\": " << sum.lengthM2P[b] << "}";
+      csv << "M2P list lengths," << (1 << b) << ",count," << sum.lengthM2P[b] << std::endl;
+    }                                                           // End loop over bins
+    json << "]," << std::endl << "  \"threads\": [";            // Work of each thread
+    for (int i=0; i<numThreads; i++) {                          // Loop over threads
+      ThreadStats & stats = threadStats[i];                     //  Statistics of thread
+      json << (i ? ", " : "") << "{\"thread\": " << i << ", \"P2P cycles\": " << stats.cyclesP2P
+	   << ", \"M2L cycles\": " << stats.cyclesM2L << ", \"M2P cycles\": " << stats.cyclesM2P
+	   << ", \"P2P body pairs\": " << stats.numP2P << ", \"M2L calls\": " << stats.numM2L
+	   << ", \"tasks\": " << stats.numTasks << "}";
+      csv << "threads," << i << ",P2P cycles," << stats.cyclesP2P << std::endl
+	  << "threads," << i << ",M2L cycles," << stats.cyclesM2L << std::endl
+	  << "threads," << i << ",M2P cycles," << stats.cyclesM2P << std::endl
+	  << "threads," << i << ",P2P body pairs," << stats.numP2P << std::endl
+	  << "threads," << i << ",M2L calls," << stats.numM2L << std::endl
+	  << "threads," << i << ",tasks," << stats.numTasks << std::endl;
+    }                                                           // End loop over threads
+    json << "]," << std::endl << "  \"timers\": {";             // Timers of the logger
+    for (logger::T_iter E=logger::timer.begin(); E!=logger::timer.end(); E++) {// Loop over all events
+      json << (E != logger::timer.begin() ? ", " : "") << "\"" << E->first << "\": " << E->second;
+      csv << "timers,," << E->first << "," << E->second << std::endl;
+    }                                                           // End loop over all events
+    json << "}" << std::endl << "}" << std::endl;               // Close JSON object
+  }
+
+  //! Print cost model and busy fraction of threads during traversal
+  void printThreadData() {
+    if (logger::verbose && cyclesTraverse > 0) {                // If verbose flag is true and traversal was run
+      logger::printTitle("Thread stats");                       //  Print title
+      std::cout << std::setw(logger::stringLength) << std::left //  Set format
+                << "P2P cost" << " : " << std::setprecision(1) << std::fixed// Set format
+                << costP2P << " cycles" << std::endl            //  Print cycles per P2P body pair
+                << std::setw(logger::stringLength) << std::left //  Set format
+                << "M2L cost" << " : " << costM2L << " cycles" << std::endl// Print cycles per M2L cell pair
+                << std::setw(logger::stringLength) << std::left //  Set format
+                << "M2P/P2L bodies" << " : " << workM2PBody.size() << " / " << workP2LBody.size() << std::endl// Print M2L break even bodies
+                << std::setw(logger::stringLength) << std::left //  Set format
+                << "Mutual M2L" << " : " << workMutualM2L << " M2L" << std::endl;// Print relative cost of mutual M2L
+#if COUNT
+      int numThreads = std::min(thread_count(), int(maxThreads));//  Number of threads with statistics
+      std::cout << std::setw(logger::stringLength) << std::left //  Set format
+                << "Threads" << " : " << numThreads << std::endl;// Print number of threads
+      double minBusy = 1, maxBusy = 0, sumBusy = 0;             //  Busy fractions of threads
+      for (int i=0; i<numThreads; i++) {                        //  Loop over threads
+        double busy = (threadStats[i].cyclesP2P + threadStats[i].cyclesM2L + threadStats[i].cyclesM2P) / cyclesTraverse;// Busy fraction
+        minBusy = std::min(minBusy, busy);                      //   Minimum busy fraction
+        maxBusy = std::max(maxBusy, busy);                      //   Maximum busy fraction
+        sumBusy += busy;                                        //   Accumulate busy fraction
+      }                                                         //  End loop over threads
+      std::cout << std::setw(logger::stringLength) << std::left //  Set format
+                << "Busy (min)" << " : " << 100 * minBusy << " %" << std::endl// Print least busy thread
+                << std::setw(logger::stringLength) << std::left //  Set format
+                << "Busy (avg)" << " : " << 100 * sumBusy / numThreads << " %" << std::endl// Print average
+                << std::setw(logger::stringLength) << std::left //  Set format
+                << "Busy (max)" << " : " << 100 * maxBusy << " %" << std::endl;// Print busiest thread
 #endif
+    }                                                           // End if for verbose flag
   }
 };
 #endif
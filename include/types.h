@@ -19,9 +19,20 @@ const real_t EPS = 1e-8;                                        //!< Single prec
 typedef std::complex<real_t> complex_t;                         //!< Complex type
 typedef vec<3,real_t>        vec3;                              //!< Vector of 3 real_t types
 
+// Expansion type definitions (MIXED keeps bodies and P2P in real_t but expansions in double)
+#if FP64 | MIXED
+typedef double                ereal_t;                          //!< Floating point type of expansions is double precision
+#else
+typedef float                 ereal_t;                          //!< Floating point type of expansions is single precision
+#endif
+typedef std::complex<ereal_t> ecomplex_t;                       //!< Complex type of expansions
+typedef vec<3,ereal_t>        evec3;                            //!< Vector of 3 ereal_t types
+
 // SIMD vector types for MIC, AVX, and SSE
 const int NSIMD = SIMD_BYTES / sizeof(real_t);                  //!< SIMD vector length (SIMD_BYTES defined in macros.h)
 typedef vec<NSIMD,real_t> simdvec;                              //!< SIMD vector type
+const int NSIMDE = SIMD_BYTES / sizeof(ereal_t);                //!< SIMD vector length for expansions
+typedef vec<NSIMDE,ereal_t> esimdvec;                           //!< SIMD vector type for expansions
 
 // Kahan summation types (Achieves quasi-double precision using single precision types)
 #if KAHAN
@@ -38,10 +49,10 @@ typedef simdvec        ksimdvec;                                //!< SIMD vector
 const int P = EXPANSION;                                        //!< Order of expansions
 #if Cartesian
 const int NTERM = P*(P+1)*(P+2)/6;                              //!< Number of Cartesian mutlipole/local terms
-typedef vec<NTERM,real_t> vecP;                                 //!< Multipole/local coefficient type for Cartesian
-#elif Spherical
+typedef vec<NTERM,ereal_t> vecP;                                //!< Multipole/local coefficient type for Cartesian
+#elif Spherical | Rotation
 const int NTERM = P*(P+1)/2;                                    //!< Number of Spherical multipole/local terms
-typedef vec<NTERM,complex_t> vecP;                              //!< Multipole/local coefficient type for spherical
+typedef vec<NTERM,ecomplex_t> vecP;                             //!< Multipole/local coefficient type for spherical
 #endif
 
 //! Center and radius of bounding box
@@ -75,6 +86,10 @@ typedef std::vector<Body,BodyAllocator>   Bodies;               //!< Vector of b
 //typedef std::vector<Body>                 Bodies;               //!< Vector of bodies
 typedef Bodies::iterator                  B_iter;               //!< Iterator of body vector
 
+#if USE_SOA
+struct BodiesSoA;                                               // Structure of arrays for bodies (bodies_soa.h)
+#endif
+
 //! Structure of cells
 struct Cell {
   int       IPARENT;                                            //!< Index of parent cell
@@ -83,10 +98,15 @@ struct Cell {
   int       IBODY;                                              //!< Index of first body
   int       NBODY;                                              //!< Number of descendant bodies
   B_iter    BODY;                                               //!< Iterator of first body
+#if USE_SOA
+  BodiesSoA * SOA;                                              //!< Streams holding the bodies of this leaf (NULL until scattered)
+  int       ISOA;                                               //!< Index of first body in SOA streams
+#endif
   uint64_t  ICELL;                                              //!< Cell index
   real_t    WEIGHT;                                             //!< Weight for partitioning
   vec3      X;                                                  //!< Cell center
   real_t    R;                                                  //!< Cell radius
+  int       ORDER;                                              //!< Expansion order of the cell as a source (at most P)
   vecP      M;                                                  //!< Multipole coefficients
   vecP      L;                                                  //!< Local coefficients
 };
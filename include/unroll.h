@@ -80,6 +80,12 @@ namespace Ops {
       return lhs = fabsf(rhs);
     }
   };
+  template<typename T> struct Sqrt {
+    __host__ __device__ __forceinline__
+    T operator() (T & lhs, const T & rhs) const {
+      return lhs = sqrtf(rhs);
+    }
+  };
   template<typename T> struct Rsqrt {
     __host__ __device__ __forceinline__
     T operator() (T & lhs, const T & rhs) const {
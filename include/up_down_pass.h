@@ -9,6 +9,7 @@ private:
   const real_t theta;                                           //!< Multipole acceptance criteria
   const bool useRmax;                                           //!< Use maximum distance for MAC
   const bool useRopt;                                           //!< Use error optimized theta for MAC
+  const real_t errorBudget;                                     //!< Relative error per cell for variable order (0 for fixed P)
 
 private:
   //! Recursive functor for error optimization of R
@@ -74,6 +75,7 @@ private:
 	create_taskc(postOrderTraversal);                       //    Create new task for recursive call
       }                                                         //   End loop over child cells
       wait_tasks;                                               //   Synchronize tasks
+      C->ORDER = P;                                             //  Full expansion order unless an error budget is set
       C->M = 0;                                                 //  Initialize multipole expansion coefficients
       C->L = 0;                                                 //  Initialize local expansion coefficients
       if(C->NCHILD==0) kernel::P2M(C);                          //  P2M kernel
@@ -110,10 +112,32 @@ private:
     }                                                           // End overload operator()
   };
 
+  //! Choose the expansion order of each cell so that its truncation error stays within the budget
+  void setOrder(Cells & cells) {
+    std::vector<real_t> charge(cells.size(), 0);                // Sum of absolute source values in each cell
+    for (int i=cells.size()-1; i>=0; i--) {                     // Loop over cells bottom up (parents come first)
+      C_iter C = cells.begin() + i;                             //  Current cell
+      if (C->NCHILD == 0) {                                     //  If leaf cell
+	for (B_iter B=C->BODY; B!=C->BODY+C->NBODY; B++) {      //   Loop over bodies in cell
+	  charge[i] += std::abs(B->SRC);                        //    Accumulate source magnitude
+	}                                                       //   End loop over bodies in cell
+      }                                                         //  End if for leaf cell
+      if (i > 0) charge[C->IPARENT] += charge[i];               //  Add to parent cell
+    }                                                           // End loop over cells
+    real_t w0 = charge[0] / cells[0].R;                         // Field strength of the root at its MAC radius
+    for (int i=0; i<int(cells.size()); i++) {                   // Loop over cells
+      C_iter C = cells.begin() + i;                             //  Current cell
+      real_t w = charge[i] / C->R;                              //  Field strength of the cell at its MAC radius
+      int p = 2;                                                //  Keep the monopole force for empty cells
+      if (w > 0) p = int(std::ceil(std::log(errorBudget * w0 / w) / std::log(theta)));// Error decays as theta^p
+      C->ORDER = std::min(std::max(p, 2), P);                   //  Clamp to [2,P]
+    }                                                           // End loop over cells
+  }
+
 public:
   //! Constructor
-  UpDownPass(real_t _theta, bool _useRmax, bool _useRopt) :
-    theta(_theta), useRmax(_useRmax), useRopt(_useRopt) {}      // Initialize variables
+  UpDownPass(real_t _theta, bool _useRmax, bool _useRopt, real_t _errorBudget=0) :
+    theta(_theta), useRmax(_useRmax), useRopt(_useRopt), errorBudget(_errorBudget) {}// Initialize variables
 
   //! Upward pass (P2M, M2M)
   void upwardPass(Cells & cells) {
@@ -127,6 +151,7 @@ public:
 	SetRopt setRopt(C0, C0, c, theta);                      //   Instantiate recursive functor
 	setRopt();                                              //   Error optimization of R
       }                                                         //  End if for using error optimized theta
+      if (errorBudget > 0) setOrder(cells);                     //  Variable expansion order per cell
     }                                                           // End if for empty cell vector
     logger::stopTimer("Upward pass");                           // Stop timer
   }
@@ -17,6 +17,10 @@ public:
   vec(const vec &v) {                                           // Copy constructor (vector)
     for (int i=0; i<N; i++) data[i] = v[i];
   }
+  template<typename U>
+  explicit vec(const vec<N,U> &v) {                             // Conversion constructor (vector of other type)
+    for (int i=0; i<N; i++) data[i] = v[i];
+  }
   ~vec(){}                                                      // Destructor
   const vec &operator=(const T v) {                             // Scalar assignment
     for (int i=0; i<N; i++) data[i] = v;
@@ -185,6 +189,11 @@ public:
     for (int i=1; i<N; i++) temp = temp > v[i] ? temp : v[i];
     return temp;
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    vec temp;
+    for (int i=0; i<N; i++) temp[i] = std::sqrt(v[i]);
+    return temp;
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
     vec temp;
     for (int i=0; i<N; i++) temp[i] = 1. / std::sqrt(v[i]);
@@ -476,6 +485,12 @@ public:
     return temp;
   }
   __device__ __forceinline__
+  friend vec sqrt(const vec & v) {                              // Square root
+    vec temp;
+    Unroll<Ops::Sqrt<T>,T,N>::loop(temp,v);
+    return temp;
+  }
+  __device__ __forceinline__
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
     vec temp;
     Unroll<Ops::Rsqrt<T>,T,N>::loop(temp,v);
@@ -505,7 +520,7 @@ public:
 };
 #endif
 
-#if __MIC__
+#if __MIC__ | __AVX512F__
 #include <immintrin.h>
 template<>
 class vec<16,float> {
@@ -570,10 +585,10 @@ public:
     return vec(_mm512_div_ps(data,v.data));
   }
   __mmask16 operator>(const vec & v) const {                    // Vector arithmetic (greater than)
-    return _mm512_cmp_ps_mask(data,v.data,_MM_CMPINT_GT);
+    return _mm512_cmplt_ps_mask(v.data,data);
   }
   __mmask16 operator<(const vec & v) const {                    // Vector arithmetic (less than)
-    return _mm512_cmp_ps_mask(data,v.data,_MM_CMPINT_LT);
+    return _mm512_cmplt_ps_mask(data,v.data);
   }
   vec operator-() const {                                       // Vector arithmetic (negation)
     return vec(_mm512_sub_ps(_mm512_setzero_ps(),data));
@@ -589,11 +604,21 @@ public:
     return s;
   }
   friend float sum(const vec & v) {                             // Sum vector
+#if __MIC__
     return _mm512_reduce_add_ps(v.data);
+#else
+    __m256 low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF,_mm512_castps_pd(v.data),0));
+    __m256 high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF,_mm512_castps_pd(v.data),1));
+    __m256 temp = _mm256_add_ps(low,high);
+    __m256 perm = _mm256_permute2f128_ps(temp,temp,1);
+    temp = _mm256_add_ps(temp,perm);
+    temp = _mm256_hadd_ps(temp,temp);
+    temp = _mm256_hadd_ps(temp,temp);
+    return ((float*)&temp)[0];
+#endif
   }
   friend float norm(const vec & v) {                            // L2 norm squared
-    __m512 temp = _mm512_mul_ps(v.data,v.data);
-    return _mm512_reduce_add_ps(temp);
+    return sum(vec(_mm512_mul_ps(v.data,v.data)));
   }
   friend vec min(const vec & v, const vec & w) {                // Element-wise minimum
     return vec(_mm512_min_ps(v.data,w.data));
@@ -601,14 +626,23 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(_mm512_max_ps(v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+#if __MIC__
+    return vec(_mm512_sqrt_ps(v.data));
+#else
+    return vec(_mm512_maskz_sqrt_ps(0xFFFF,v.data));            // Zero masked lanes rather than undefined ones
+#endif
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
-#if NEWTON                                                      // Switch on Newton-Raphson correction
+#if __MIC__
     vec temp = vec(_mm512_rsqrt23_ps(v.data));
-    temp *= (temp * temp * v - 3.0f) * (-0.5f);
-    return temp;
 #else
-    return vec(_mm512_rsqrt23_ps(v.data));
+    vec temp = vec(_mm512_maskz_rsqrt14_ps(0xFFFF,v.data));
 #endif
+#if NEWTON                                                      // Switch on Newton-Raphson correction
+    temp *= (temp * temp * v - 3.0f) * (-0.5f);
+#endif
+    return temp;
   }
 };
 
@@ -673,10 +707,10 @@ public:
     return vec(_mm512_div_pd(data,v.data));
   }
   __mmask8 operator>(const vec & v) const {                     // Vector arithmetic (greater than)
-    return _mm512_cmp_pd_mask(data,v.data,_MM_CMPINT_GT);
+    return _mm512_cmplt_pd_mask(v.data,data);
   }
   __mmask8 operator<(const vec & v) const {                     // Vector arithmetic (less than)
-    return _mm512_cmp_pd_mask(data,v.data,_MM_CMPINT_LT);
+    return _mm512_cmplt_pd_mask(data,v.data);
   }
   vec operator-() const {                                       // Vector arithmetic (negation)
     return vec(_mm512_sub_pd(_mm512_setzero_pd(),data));
@@ -692,11 +726,18 @@ public:
     return s;
   }
   friend double sum(const vec & v) {                            // Sum vector
+#if __MIC__
     return _mm512_reduce_add_pd(v.data);
+#else
+    __m256d temp = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF,v.data,0),_mm512_maskz_extractf64x4_pd(0xFF,v.data,1));
+    __m256d perm = _mm256_permute2f128_pd(temp,temp,1);
+    temp = _mm256_add_pd(temp,perm);
+    temp = _mm256_hadd_pd(temp,temp);
+    return ((double*)&temp)[0];
+#endif
   }
   friend double norm(const vec & v) {                           // L2 norm squared
-    __m512d temp = _mm512_mul_pd(v.data,v.data);;
-    return _mm512_reduce_add_pd(temp);
+    return sum(vec(_mm512_mul_pd(v.data,v.data)));
   }
   friend vec min(const vec & v, const vec & w) {                // Element-wise minimum
     return vec(_mm512_min_pd(v.data,w.data));
@@ -704,16 +745,28 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(_mm512_max_pd(v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+#if __MIC__
+    return vec(_mm512_sqrt_pd(v.data));
+#else
+    return vec(_mm512_maskz_sqrt_pd(0xFF,v.data));              // Zero masked lanes rather than undefined ones
+#endif
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
-#if NEWTON
+#if NEWTON && __MIC__
     vec<16,float> in(v[0],v[1],v[2],v[3],v[4],v[5],v[6],v[7],0,0,0,0,0,0,0,0);
     vec<16,float> temp = rsqrt(in);
     temp *= (temp * temp * in - 3.0f) * (-0.5f);
     vec<8,double> out(temp[0],temp[1],temp[2],temp[3],temp[4],temp[5],temp[6],temp[7]);
     return out;
+#elif NEWTON
+    vec temp = vec(_mm512_maskz_rsqrt14_pd(0xFF,v.data));       // 14 bit estimate
+    temp *= (temp * temp * v - 3.0) * (-0.5);                   // 28 bits after one Newton-Raphson step
+    temp *= (temp * temp * v - 3.0) * (-0.5);                   // Full precision after two steps
+    return temp;
 #else
     vec one = 1;
-    return vec(_mm512_div_pd(one.data,_mm512_sqrt_pd(v.data)));
+    return vec(_mm512_div_pd(one.data,sqrt(v).data));
 #endif
   }
 };
@@ -821,6 +874,9 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(_mm256_max_ps(v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    return vec(_mm256_sqrt_ps(v.data));
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
 #if NEWTON                                                      // Switch on Newton-Raphson correction
     vec temp = vec(_mm256_rsqrt_ps(v.data));
@@ -930,6 +986,9 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(_mm256_max_pd(v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    return vec(_mm256_sqrt_pd(v.data));
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
 #if NEWTON                                                      // Switch on Newton-Raphson correction
     vec<8,float> in(v[0],v[1],v[2],v[3],0,0,0,0);
@@ -1047,6 +1106,11 @@ public:
     for (int i=0; i<4; i++) temp[i] = v[i] > w[i] ? v[i] : w[i];
     return temp;
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    vec temp;
+    for (int i=0; i<4; i++) temp[i] = std::sqrt(v[i]);
+    return temp;
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
 #if NEWTON                                                      // Switch on Newton-Raphson correction
     vec temp = vec(vec_rsqrtes(v.data));
@@ -1157,6 +1221,9 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(_mm_max_ps(v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    return vec(_mm_sqrt_ps(v.data));
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
 #if NEWTON                                                      // Switch on Newton-Raphson correction
     vec temp = vec(_mm_rsqrt_ps(v.data));
@@ -1261,6 +1328,9 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(_mm_max_pd(v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    return vec(_mm_sqrt_pd(v.data));
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
 #if NEWTON                                                      // Switch on Newton-Raphson correction
     vec<4,float> in(v[0],v[1],0,0);
@@ -1369,6 +1439,11 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(_mm_max_pd(v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    vec temp;
+    for (int i=0; i<2; i++) temp[i] = std::sqrt(v[i]);
+    return temp;
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
 #if NEWTON                                                      // Switch on Newton-Raphson correction
     vec temp = vec(_fjsp_rsqrta_v2r8(v.data));
@@ -1486,6 +1561,11 @@ public:
   friend vec max(const vec & v, const vec & w) {                // Element-wise maximum
     return vec(__fpsel(v.data-w.data,v.data,w.data));
   }
+  friend vec sqrt(const vec & v) {                              // Square root
+    vec temp;
+    for (int i=0; i<2; i++) temp[i] = std::sqrt(v[i]);
+    return temp;
+  }
   friend vec rsqrt(const vec & v) {                             // Reciprocal square root
 #if NEWTON                                                      // Switch on Newton-Raphson correction
     vec temp = vec(__fprsqrte(v.data));
@@ -1,24 +1,565 @@
 #include "kernel.h"
 #include "simdvec.h"
 
-void kernel::P2P(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic, bool mutual) {
+#if USE_SIMD
+const int NSOURCE = 256;                                        //!< Sources per block of the source vectorized P2P
+
+//! Vectorize over sources if that leaves fewer SIMD lanes idle than vectorizing over targets
+static inline bool sourceSIMD(int ni, int nj) {
+  return (nj + NSIMD - 1) / NSIMD * ni < (ni + NSIMD - 1) / NSIMD * nj;
+}
+#endif
+
+#if USE_SOA
+#include "bodies_soa.h"
+
+#if USE_SIMD
+//! P2P vectorized over sources with one horizontal sum per target
+template<bool soft, bool periodic, bool mutual>
+static void P2PSource(BodiesSoA & Bi, int i0, int ni, BodiesSoA & Bj, int j0, int nj,
+                      real_t eps2, vec3 Xperiodic) {
+  if (!soft) eps2 = 0;                                          // Drop the softening at compile time
+  if (!periodic) Xperiodic = 0;                                 // Drop the periodic shift at compile time
+  const int nb = NSOURCE / NSIMD;
+  simdvec zero = 0.0;
+  simdvec pj[nb], xj[nb], yj[nb], zj[nb];
+  for (int jb=0; jb<nj; jb+=NSOURCE) {
+    int n = std::min(NSOURCE, nj - jb);
+    for (int b=0; b<nb; b++) {
+      pj[b] = xj[b] = yj[b] = zj[b] = zero;
+    }
+    for (int i=i0; i<i0+ni; i++) {
+      ksimdvec pot = zero;
+      ksimdvec ax = zero;
+      ksimdvec ay = zero;
+      ksimdvec az = zero;
+      simdvec xi = Bi.X[0][i] - Xperiodic[0];
+      simdvec yi = Bi.X[1][i] - Xperiodic[1];
+      simdvec zi = Bi.X[2][i] - Xperiodic[2];
+      simdvec mi = Bi.SRC[i];
+      for (int b=0, j=j0+jb; j<j0+jb+n; b++, j+=NSIMD) {
+        simdvec dx = xi - loadSoA<simdvec>(&Bj.X[0][j]);
+        simdvec dy = yi - loadSoA<simdvec>(&Bj.X[1][j]);
+        simdvec dz = zi - loadSoA<simdvec>(&Bj.X[2][j]);
+        simdvec R2 = eps2;
+        R2 += dx * dx;
+        R2 += dy * dy;
+        R2 += dz * dz;
+        simdvec invR = rsqrt(R2);
+        invR &= R2 > zero;
+
+        simdvec mj = loadSoA<simdvec>(&Bj.SRC[j]);
+        mj *= invR * mi;
+        pot += mj;
+        invR = invR * invR * mj;
+        dx *= invR;
+        ax += dx;
+        dy *= invR;
+        ay += dy;
+        dz *= invR;
+        az += dz;
+        if (mutual) {
+          pj[b] += mj;
+          xj[b] += dx;
+          yj[b] += dy;
+          zj[b] += dz;
+        }
+      }
+      Bi.TRG[0][i] += reduce(pot);
+      Bi.TRG[1][i] -= reduce(ax);
+      Bi.TRG[2][i] -= reduce(ay);
+      Bi.TRG[3][i] -= reduce(az);
+    }
+    if (mutual) {
+      for (int j=0; j<n; j++) {
+        Bj.TRG[0][j0+jb+j] += pj[j/NSIMD][j%NSIMD];
+        Bj.TRG[1][j0+jb+j] += xj[j/NSIMD][j%NSIMD];
+        Bj.TRG[2][j0+jb+j] += yj[j/NSIMD][j%NSIMD];
+        Bj.TRG[3][j0+jb+j] += zj[j/NSIMD][j%NSIMD];
+      }
+    }
+  }
+}
+
+//! Mutual P2P that rotates tiles of NSIMD sources one lane at a time past the targets,
+//! so that the source reactions stay in SIMD registers and are reduced once per tile
+template<bool self, bool soft, bool periodic>
+static void P2PMutual(BodiesSoA & Bi, int i0, int ni, BodiesSoA & Bj, int j0, int nj,
+                      real_t eps2, vec3 Xperiodic) {
+  if (!soft) eps2 = 0;                                          // Drop the softening at compile time
+  if (!periodic) Xperiodic = 0;                                 // Drop the periodic shift at compile time
+  const int nb = NSOURCE / NSIMD;
+  simdvec zero = 0.0;
+  simdvec xi[nb], yi[nb], zi[nb], mi[nb], ii[nb];
+  ksimdvec pot[nb], ax[nb], ay[nb], az[nb];
+  real_t Xj[5][2*NSIMD];                                        // Source tile stored twice, a rotation is an offset
+  real_t Fj[4][NSIMD][2*NSIMD];                                 // Source reactions of each rotation stored twice
+  for (int ib=0; ib<ni; ib+=NSOURCE) {
+    int m = (std::min(NSOURCE, ni - ib) + NSIMD - 1) / NSIMD;
+    for (int b=0; b<m; b++) {
+      int i = ib + b * NSIMD;
+      xi[b] = loadSoA<simdvec>(&Bi.X[0][i0+i]) - simdvec(Xperiodic[0]);
+      yi[b] = loadSoA<simdvec>(&Bi.X[1][i0+i]) - simdvec(Xperiodic[1]);
+      zi[b] = loadSoA<simdvec>(&Bi.X[2][i0+i]) - simdvec(Xperiodic[2]);
+      mi[b] = loadSoA<simdvec>(&Bi.SRC[i0+i]);
+      ii[b] = SIMD<simdvec,0,NSIMD>::setIndex(i);
+      pot[b] = ax[b] = ay[b] = az[b] = zero;
+    }
+    for (int jb=self ? ib : 0; jb<nj; jb+=NSIMD) {
+      simdvec tile[5];
+      for (int d=0; d<3; d++) tile[d] = loadSoA<simdvec>(&Bj.X[d][j0+jb]);
+      tile[3] = loadSoA<simdvec>(&Bj.SRC[j0+jb]);
+      tile[4] = SIMD<simdvec,0,NSIMD>::setIndex(jb);
+      for (int d=0; d<5; d++) {
+        storeUnaligned(&Xj[d][0], tile[d]);
+        storeUnaligned(&Xj[d][NSIMD], tile[d]);
+      }
+      int mb = self ? std::min(m, (jb - ib) / NSIMD + 1) : m;
+      for (int s=0; s<NSIMD; s++) {
+        simdvec xj = loadUnaligned<simdvec>(&Xj[0][s]);
+        simdvec yj = loadUnaligned<simdvec>(&Xj[1][s]);
+        simdvec zj = loadUnaligned<simdvec>(&Xj[2][s]);
+        simdvec mj = loadUnaligned<simdvec>(&Xj[3][s]);
+        simdvec jj = loadUnaligned<simdvec>(&Xj[4][s]);
+        simdvec pj = zero;
+        simdvec fx = zero;
+        simdvec fy = zero;
+        simdvec fz = zero;
+        for (int b=0; b<mb; b++) {
+          simdvec dx = xi[b] - xj;
+          simdvec dy = yi[b] - yj;
+          simdvec dz = zi[b] - zj;
+          simdvec R2 = eps2;
+          R2 += dx * dx;
+          R2 += dy * dy;
+          R2 += dz * dz;
+          simdvec invR = rsqrt(R2);
+          if (self) invR &= ii[b] < jj;
+          invR &= R2 > zero;
+
+          simdvec mij = mj * invR * mi[b];
+          pot[b] += mij;
+          pj += mij;
+          invR = invR * invR * mij;
+          dx *= invR;
+          ax[b] += dx;
+          fx += dx;
+          dy *= invR;
+          ay[b] += dy;
+          fy += dy;
+          dz *= invR;
+          az[b] += dz;
+          fz += dz;
+        }
+        storeUnaligned(&Fj[0][s][0], pj);
+        storeUnaligned(&Fj[0][s][NSIMD], pj);
+        storeUnaligned(&Fj[1][s][0], fx);
+        storeUnaligned(&Fj[1][s][NSIMD], fx);
+        storeUnaligned(&Fj[2][s][0], fy);
+        storeUnaligned(&Fj[2][s][NSIMD], fy);
+        storeUnaligned(&Fj[3][s][0], fz);
+        storeUnaligned(&Fj[3][s][NSIMD], fz);
+      }
+      for (int q=0; q<4; q++) {                                 // Lane k of rotation s belongs to source (k+s)%NSIMD
+        simdvec f = zero;
+        for (int s=0; s<NSIMD; s++) f += loadUnaligned<simdvec>(&Fj[q][s][NSIMD-s]);
+        for (int k=0; k<NSIMD && jb+k<nj; k++) Bj.TRG[q][j0+jb+k] += f[k];
+      }
+    }
+    for (int b=0; b<m; b++) {
+      for (int k=0, i=ib+b*NSIMD; k<NSIMD && i<ni; k++, i++) {
+        Bi.TRG[0][i0+i] += transpose(pot[b],k);
+        Bi.TRG[1][i0+i] -= transpose(ax[b],k);
+        Bi.TRG[2][i0+i] -= transpose(ay[b],k);
+        Bi.TRG[3][i0+i] -= transpose(az[b],k);
+      }
+    }
+  }
+}
+#endif
+
+//! P2P kernel between cells Ci and Cj specialized on softening, periodic shift and mutual update
+template<bool soft, bool periodic, bool mutual>
+static void P2PPair(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic) {
+  if (!soft) eps2 = 0;                                          // Drop the softening at compile time
+  if (!periodic) Xperiodic = 0;                                 // Drop the periodic shift at compile time
+  assert(Ci->SOA != NULL && Cj->SOA != NULL);                  // Bodies must be scattered to SoA streams
+  BodiesSoA & Bi = *Ci->SOA;
+  BodiesSoA & Bj = *Cj->SOA;
+  int i0 = Ci->ISOA;
+  int j0 = Cj->ISOA;
+  int ni = Ci->NBODY;
+  int nj = Cj->NBODY;
+  int i = 0;
+#if USE_SIMD
+  if (sourceSIMD(ni, nj)) {
+    P2PSource<soft,periodic,mutual>(Bi, i0, ni, Bj, j0, nj, eps2, Xperiodic);
+    return;
+  }
+  if (mutual) {
+    P2PMutual<false,soft,periodic>(Bi, i0, ni, Bj, j0, nj, eps2, Xperiodic);
+    return;
+  }
+  for ( ; i<ni; i+=NSIMD) {
+    simdvec zero = 0.0;
+    ksimdvec pot = zero;
+    ksimdvec ax = zero;
+    ksimdvec ay = zero;
+    ksimdvec az = zero;
+
+    simdvec xi = loadSoA<simdvec>(&Bi.X[0][i0+i]);
+    simdvec yi = loadSoA<simdvec>(&Bi.X[1][i0+i]);
+    simdvec zi = loadSoA<simdvec>(&Bi.X[2][i0+i]);
+    simdvec mi = loadSoA<simdvec>(&Bi.SRC[i0+i]);
+    simdvec xp = Xperiodic[0];
+    xi -= xp;
+    simdvec yp = Xperiodic[1];
+    yi -= yp;
+    simdvec zp = Xperiodic[2];
+    zi -= zp;
+
+    for (int j=j0; j<j0+nj; j++) {
+      simdvec xj = Bj.X[0][j];
+      xj -= xi;
+      simdvec yj = Bj.X[1][j];
+      yj -= yi;
+      simdvec zj = Bj.X[2][j];
+      zj -= zi;
+      simdvec R2 = eps2;
+      R2 += xj * xj;
+      R2 += yj * yj;
+      R2 += zj * zj;
+      simdvec invR = rsqrt(R2);
+      invR &= R2 > zero;
+
+      simdvec mj = Bj.SRC[j];
+      mj *= invR * mi;
+      pot += mj;
+      invR = invR * invR * mj;
+
+      xj *= invR;
+      ax += xj;
+      yj *= invR;
+      ay += yj;
+      zj *= invR;
+      az += zj;
+    }
+    for (int k=0; k<NSIMD && i+k<ni; k++) {
+      Bi.TRG[0][i0+i+k] += transpose(pot,k);
+      Bi.TRG[1][i0+i+k] += transpose(ax,k);
+      Bi.TRG[2][i0+i+k] += transpose(ay,k);
+      Bi.TRG[3][i0+i+k] += transpose(az,k);
+    }
+  }
+#endif
+  for ( ; i<ni; i++) {
+    kreal_t pot = 0;
+    kreal_t ax = 0;
+    kreal_t ay = 0;
+    kreal_t az = 0;
+    for (int j=j0; j<j0+nj; j++) {
+      vec3 dX;
+      for (int d=0; d<3; d++) dX[d] = Bi.X[d][i0+i] - Bj.X[d][j] - Xperiodic[d];
+      real_t R2 = norm(dX) + eps2;
+      if (R2 != 0) {
+        real_t invR2 = 1.0 / R2;
+        real_t invR = Bi.SRC[i0+i] * Bj.SRC[j] * sqrt(invR2);
+        dX *= invR2 * invR;
+        pot += invR;
+        ax += dX[0];
+        ay += dX[1];
+        az += dX[2];
+        if (mutual) {
+          Bj.TRG[0][j] += invR;
+          Bj.TRG[1][j] += dX[0];
+          Bj.TRG[2][j] += dX[1];
+          Bj.TRG[3][j] += dX[2];
+        }
+      }
+    }
+    Bi.TRG[0][i0+i] += pot;
+    Bi.TRG[1][i0+i] -= ax;
+    Bi.TRG[2][i0+i] -= ay;
+    Bi.TRG[3][i0+i] -= az;
+  }
+}
+
+void kernel::P2P(C_iter C, real_t eps2) {
+  assert(C->SOA != NULL);                                      // Bodies must be scattered to SoA streams
+  BodiesSoA & B = *C->SOA;
+  int i0 = C->ISOA;
+  int n = C->NBODY;
+  int i = 0;
+#if USE_SIMD
+  if (eps2 != 0) P2PMutual<true,true,false>(B, i0, n, B, i0, n, eps2, 0.0);
+  else P2PMutual<true,false,false>(B, i0, n, B, i0, n, eps2, 0.0);
+  return;
+#endif
+  for ( ; i<n; i++) {
+    kreal_t pot = 0;
+    kreal_t ax = 0;
+    kreal_t ay = 0;
+    kreal_t az = 0;
+    for (int j=i+1; j<n; j++) {
+      vec3 dX;
+      for (int d=0; d<3; d++) dX[d] = B.X[d][i0+i] - B.X[d][i0+j];
+      real_t R2 = norm(dX) + eps2;
+      if (R2 != 0) {
+        real_t invR2 = 1.0 / R2;
+        real_t invR = B.SRC[i0+i] * B.SRC[i0+j] * sqrt(invR2);
+        dX *= invR2 * invR;
+        pot += invR;
+        ax += dX[0];
+        ay += dX[1];
+        az += dX[2];
+        B.TRG[0][i0+j] += invR;
+        B.TRG[1][i0+j] += dX[0];
+        B.TRG[2][i0+j] += dX[1];
+        B.TRG[3][i0+j] += dX[2];
+      }
+    }
+    B.TRG[0][i0+i] += pot;
+    B.TRG[1][i0+i] -= ax;
+    B.TRG[2][i0+i] -= ay;
+    B.TRG[3][i0+i] -= az;
+  }
+}
+
+#else
+#if USE_SIMD
+//! P2P vectorized over sources with one horizontal sum per target (sources are gathered once per block)
+template<bool soft, bool periodic, bool mutual>
+static void P2PSource(B_iter Bi, int ni, B_iter Bj, int nj, real_t eps2, vec3 Xperiodic) {
+  if (!soft) eps2 = 0;                                          // Drop the softening at compile time
+  if (!periodic) Xperiodic = 0;                                 // Drop the periodic shift at compile time
+  const int nb = NSOURCE / NSIMD;
+  simdvec zero = 0.0;
+  simdvec xs[nb], ys[nb], zs[nb], ms[nb];
+  simdvec pj[nb], xj[nb], yj[nb], zj[nb];
+  for (int jb=0; jb<nj; jb+=NSOURCE) {
+    int n = std::min(NSOURCE, nj - jb);
+    int m = (n + NSIMD - 1) / NSIMD;
+    for (int b=0; b<m; b++) {
+      int j = jb + b * NSIMD;
+      if (j + NSIMD <= nj) {
+        xs[b] = SIMD<simdvec,0,NSIMD>::setBody(Bj,j);
+        ys[b] = SIMD<simdvec,1,NSIMD>::setBody(Bj,j);
+        zs[b] = SIMD<simdvec,2,NSIMD>::setBody(Bj,j);
+        ms[b] = SIMD<simdvec,3,NSIMD>::setBody(Bj,j);
+      } else {
+        xs[b] = SIMDTail<simdvec,0>::setBody(Bj,j,nj-j);
+        ys[b] = SIMDTail<simdvec,1>::setBody(Bj,j,nj-j);
+        zs[b] = SIMDTail<simdvec,2>::setBody(Bj,j,nj-j);
+        ms[b] = SIMDTail<simdvec,3>::setBody(Bj,j,nj-j);
+      }
+      pj[b] = xj[b] = yj[b] = zj[b] = zero;
+    }
+    for (int i=0; i<ni; i++) {
+      ksimdvec pot = zero;
+      ksimdvec ax = zero;
+      ksimdvec ay = zero;
+      ksimdvec az = zero;
+      simdvec xi = Bi[i].X[0] - Xperiodic[0];
+      simdvec yi = Bi[i].X[1] - Xperiodic[1];
+      simdvec zi = Bi[i].X[2] - Xperiodic[2];
+      simdvec mi = Bi[i].SRC;
+      for (int b=0; b<m; b++) {
+        simdvec dx = xi - xs[b];
+        simdvec dy = yi - ys[b];
+        simdvec dz = zi - zs[b];
+        simdvec R2 = eps2;
+        R2 += dx * dx;
+        R2 += dy * dy;
+        R2 += dz * dz;
+        simdvec invR = rsqrt(R2);
+        invR &= R2 > zero;
+
+        simdvec mj = ms[b];
+        mj *= invR * mi;
+        pot += mj;
+        invR = invR * invR * mj;
+        dx *= invR;
+        ax += dx;
+        dy *= invR;
+        ay += dy;
+        dz *= invR;
+        az += dz;
+        if (mutual) {
+          pj[b] += mj;
+          xj[b] += dx;
+          yj[b] += dy;
+          zj[b] += dz;
+        }
+      }
+      Bi[i].TRG[0] += reduce(pot);
+      Bi[i].TRG[1] -= reduce(ax);
+      Bi[i].TRG[2] -= reduce(ay);
+      Bi[i].TRG[3] -= reduce(az);
+    }
+    if (mutual) {
+      for (int j=0; j<n; j++) {
+        Bj[jb+j].TRG[0] += pj[j/NSIMD][j%NSIMD];
+        Bj[jb+j].TRG[1] += xj[j/NSIMD][j%NSIMD];
+        Bj[jb+j].TRG[2] += yj[j/NSIMD][j%NSIMD];
+        Bj[jb+j].TRG[3] += zj[j/NSIMD][j%NSIMD];
+      }
+    }
+  }
+}
+
+//! Mutual P2P that rotates tiles of NSIMD sources one lane at a time past the targets,
+//! so that the source reactions stay in SIMD registers and are reduced once per tile
+template<bool self, bool soft, bool periodic>
+static void P2PMutual(B_iter Bi, int ni, B_iter Bj, int nj, real_t eps2, vec3 Xperiodic) {
+  if (!soft) eps2 = 0;                                          // Drop the softening at compile time
+  if (!periodic) Xperiodic = 0;                                 // Drop the periodic shift at compile time
+  const int nb = NSOURCE / NSIMD;
+  simdvec zero = 0.0;
+  simdvec xi[nb], yi[nb], zi[nb], mi[nb], ii[nb];
+  ksimdvec pot[nb], ax[nb], ay[nb], az[nb];
+  real_t Xj[5][2*NSIMD];                                        // Source tile stored twice, a rotation is an offset
+  real_t Fj[4][NSIMD][2*NSIMD];                                 // Source reactions of each rotation stored twice
+  for (int ib=0; ib<ni; ib+=NSOURCE) {
+    int m = (std::min(NSOURCE, ni - ib) + NSIMD - 1) / NSIMD;
+    for (int b=0; b<m; b++) {
+      int i = ib + b * NSIMD;
+      if (i + NSIMD <= ni) {
+        xi[b] = SIMD<simdvec,0,NSIMD>::setBody(Bi,i);
+        yi[b] = SIMD<simdvec,1,NSIMD>::setBody(Bi,i);
+        zi[b] = SIMD<simdvec,2,NSIMD>::setBody(Bi,i);
+        mi[b] = SIMD<simdvec,3,NSIMD>::setBody(Bi,i);
+      } else {
+        xi[b] = SIMDTail<simdvec,0>::setBody(Bi,i,ni-i);
+        yi[b] = SIMDTail<simdvec,1>::setBody(Bi,i,ni-i);
+        zi[b] = SIMDTail<simdvec,2>::setBody(Bi,i,ni-i);
+        mi[b] = SIMDTail<simdvec,3>::setBody(Bi,i,ni-i);
+      }
+      xi[b] -= simdvec(Xperiodic[0]);
+      yi[b] -= simdvec(Xperiodic[1]);
+      zi[b] -= simdvec(Xperiodic[2]);
+      ii[b] = SIMD<simdvec,0,NSIMD>::setIndex(i);
+      pot[b] = ax[b] = ay[b] = az[b] = zero;
+    }
+    for (int jb=self ? ib : 0; jb<nj; jb+=NSIMD) {
+      simdvec tile[5];
+      if (jb + NSIMD <= nj) {
+        tile[0] = SIMD<simdvec,0,NSIMD>::setBody(Bj,jb);
+        tile[1] = SIMD<simdvec,1,NSIMD>::setBody(Bj,jb);
+        tile[2] = SIMD<simdvec,2,NSIMD>::setBody(Bj,jb);
+        tile[3] = SIMD<simdvec,3,NSIMD>::setBody(Bj,jb);
+      } else {
+        tile[0] = SIMDTail<simdvec,0>::setBody(Bj,jb,nj-jb);
+        tile[1] = SIMDTail<simdvec,1>::setBody(Bj,jb,nj-jb);
+        tile[2] = SIMDTail<simdvec,2>::setBody(Bj,jb,nj-jb);
+        tile[3] = SIMDTail<simdvec,3>::setBody(Bj,jb,nj-jb);
+      }
+      tile[4] = SIMD<simdvec,0,NSIMD>::setIndex(jb);
+      for (int d=0; d<5; d++) {
+        storeUnaligned(&Xj[d][0], tile[d]);
+        storeUnaligned(&Xj[d][NSIMD], tile[d]);
+      }
+      int mb = self ? std::min(m, (jb - ib) / NSIMD + 1) : m;
+      for (int s=0; s<NSIMD; s++) {
+        simdvec xj = loadUnaligned<simdvec>(&Xj[0][s]);
+        simdvec yj = loadUnaligned<simdvec>(&Xj[1][s]);
+        simdvec zj = loadUnaligned<simdvec>(&Xj[2][s]);
+        simdvec mj = loadUnaligned<simdvec>(&Xj[3][s]);
+        simdvec jj = loadUnaligned<simdvec>(&Xj[4][s]);
+        simdvec pj = zero;
+        simdvec fx = zero;
+        simdvec fy = zero;
+        simdvec fz = zero;
+        for (int b=0; b<mb; b++) {
+          simdvec dx = xi[b] - xj;
+          simdvec dy = yi[b] - yj;
+          simdvec dz = zi[b] - zj;
+          simdvec R2 = eps2;
+          R2 += dx * dx;
+          R2 += dy * dy;
+          R2 += dz * dz;
+          simdvec invR = rsqrt(R2);
+          if (self) invR &= ii[b] < jj;
+          invR &= R2 > zero;
+
+          simdvec mij = mj * invR * mi[b];
+          pot[b] += mij;
+          pj += mij;
+          invR = invR * invR * mij;
+          dx *= invR;
+          ax[b] += dx;
+          fx += dx;
+          dy *= invR;
+          ay[b] += dy;
+          fy += dy;
+          dz *= invR;
+          az[b] += dz;
+          fz += dz;
+        }
+        storeUnaligned(&Fj[0][s][0], pj);
+        storeUnaligned(&Fj[0][s][NSIMD], pj);
+        storeUnaligned(&Fj[1][s][0], fx);
+        storeUnaligned(&Fj[1][s][NSIMD], fx);
+        storeUnaligned(&Fj[2][s][0], fy);
+        storeUnaligned(&Fj[2][s][NSIMD], fy);
+        storeUnaligned(&Fj[3][s][0], fz);
+        storeUnaligned(&Fj[3][s][NSIMD], fz);
+      }
+      for (int q=0; q<4; q++) {                                 // Lane k of rotation s belongs to source (k+s)%NSIMD
+        simdvec f = zero;
+        for (int s=0; s<NSIMD; s++) f += loadUnaligned<simdvec>(&Fj[q][s][NSIMD-s]);
+        for (int k=0; k<NSIMD && jb+k<nj; k++) Bj[jb+k].TRG[q] += f[k];
+      }
+    }
+    for (int b=0; b<m; b++) {
+      for (int k=0, i=ib+b*NSIMD; k<NSIMD && i<ni; k++, i++) {
+        Bi[i].TRG[0] += transpose(pot[b],k);
+        Bi[i].TRG[1] -= transpose(ax[b],k);
+        Bi[i].TRG[2] -= transpose(ay[b],k);
+        Bi[i].TRG[3] -= transpose(az[b],k);
+      }
+    }
+  }
+}
+#endif
+
+//! P2P kernel between cells Ci and Cj specialized on softening, periodic shift and mutual update
+template<bool soft, bool periodic, bool mutual>
+static void P2PPair(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic) {
+  if (!soft) eps2 = 0;                                          // Drop the softening at compile time
+  if (!periodic) Xperiodic = 0;                                 // Drop the periodic shift at compile time
   B_iter Bi = Ci->BODY;
   B_iter Bj = Cj->BODY;
   int ni = Ci->NBODY;
   int nj = Cj->NBODY;
   int i = 0;
 #if USE_SIMD
-  for ( ; i<=ni-NSIMD; i+=NSIMD) {
+  if (sourceSIMD(ni, nj)) {
+    P2PSource<soft,periodic,mutual>(Bi, ni, Bj, nj, eps2, Xperiodic);
+    return;
+  }
+  if (mutual) {
+    P2PMutual<false,soft,periodic>(Bi, ni, Bj, nj, eps2, Xperiodic);
+    return;
+  }
+  for ( ; i<ni; i+=NSIMD) {
     simdvec zero = 0.0;
     ksimdvec pot = zero;
     ksimdvec ax = zero;
     ksimdvec ay = zero;
     ksimdvec az = zero;
 
-    simdvec xi = SIMD<simdvec,0,NSIMD>::setBody(Bi,i);
-    simdvec yi = SIMD<simdvec,1,NSIMD>::setBody(Bi,i);
-    simdvec zi = SIMD<simdvec,2,NSIMD>::setBody(Bi,i);
-    simdvec mi = SIMD<simdvec,3,NSIMD>::setBody(Bi,i);
+    simdvec xi, yi, zi, mi;
+    if (i + NSIMD <= ni) {
+      xi = SIMD<simdvec,0,NSIMD>::setBody(Bi,i);
+      yi = SIMD<simdvec,1,NSIMD>::setBody(Bi,i);
+      zi = SIMD<simdvec,2,NSIMD>::setBody(Bi,i);
+      mi = SIMD<simdvec,3,NSIMD>::setBody(Bi,i);
+    } else {
+      xi = SIMDTail<simdvec,0>::setBody(Bi,i,ni-i);
+      yi = SIMDTail<simdvec,1>::setBody(Bi,i,ni-i);
+      zi = SIMDTail<simdvec,2>::setBody(Bi,i,ni-i);
+      mi = SIMDTail<simdvec,3>::setBody(Bi,i,ni-i);
+    }
     simdvec R2 = eps2;
 
     simdvec xj = Xperiodic[0];
@@ -57,27 +598,23 @@ void kernel::P2P(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic, bool mutual)
 
       mj *= invR * mi;
       pot += mj;
-      if (mutual) Bj[j].TRG[0] += sum(mj);
       invR = invR * invR * mj;
       mj = Bj[j+1].SRC;
 
       xj *= invR;
       ax += xj;
-      if (mutual) Bj[j].TRG[1] -= sum(xj);
       xj = x2;
       R2 += x2 * x2;
       x2 = Bj[j+2].X[0];
 
       yj *= invR;
       ay += yj;
-      if (mutual) Bj[j].TRG[2] -= sum(yj);
       yj = y2;
       R2 += y2 * y2;
       y2 = Bj[j+2].X[1];
 
       zj *= invR;
       az += zj;
-      if (mutual) Bj[j].TRG[3] -= sum(zj);
       zj = z2;
       R2 += z2 * z2;
       z2 = Bj[j+2].X[2];
@@ -92,25 +629,21 @@ void kernel::P2P(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic, bool mutual)
 
       mj *= invR * mi;
       pot += mj;
-      if (mutual) Bj[nj-2].TRG[0] += sum(mj);
       invR = invR * invR * mj;
       mj = Bj[nj-1].SRC;
 
       xj *= invR;
       ax += xj;
-      if (mutual) Bj[nj-2].TRG[1] -= sum(xj);
       xj = x2;
       R2 += x2 * x2;
 
       yj *= invR;
       ay += yj;
-      if (mutual) Bj[nj-2].TRG[2] -= sum(yj);
       yj = y2;
       R2 += y2 * y2;
 
       zj *= invR;
       az += zj;
-      if (mutual) Bj[nj-2].TRG[3] -= sum(zj);
       zj = z2;
       R2 += z2 * z2;
     }
@@ -118,19 +651,15 @@ void kernel::P2P(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic, bool mutual)
     invR &= R2 > zero;
     mj *= invR * mi;
     pot += mj;
-    if (mutual) Bj[nj-1].TRG[0] += sum(mj);
     invR = invR * invR * mj;
 
     xj *= invR;
     ax += xj;
-    if (mutual) Bj[nj-1].TRG[1] -= sum(xj);
     yj *= invR;
     ay += yj;
-    if (mutual) Bj[nj-1].TRG[2] -= sum(yj);
     zj *= invR;
     az += zj;
-    if (mutual) Bj[nj-1].TRG[3] -= sum(zj);
-    for (int k=0; k<NSIMD; k++) {
+    for (int k=0; k<NSIMD && i+k<ni; k++) {
       Bi[i+k].TRG[0] += transpose(pot,k);
       Bi[i+k].TRG[1] += transpose(ax,k);
       Bi[i+k].TRG[2] += transpose(ay,k);
@@ -174,132 +703,9 @@ void kernel::P2P(C_iter C, real_t eps2) {
   int n = C->NBODY;
   int i = 0;
 #if USE_SIMD
-  for ( ; i<=n-NSIMD; i+=NSIMD) {
-    simdvec zero = 0;
-    ksimdvec pot = zero;
-    ksimdvec ax = zero;
-    ksimdvec ay = zero;
-    ksimdvec az = zero;
-
-    simdvec index = SIMD<simdvec,0,NSIMD>::setIndex(i);
-    simdvec xi = SIMD<simdvec,0,NSIMD>::setBody(B,i);
-    simdvec yi = SIMD<simdvec,1,NSIMD>::setBody(B,i);
-    simdvec zi = SIMD<simdvec,2,NSIMD>::setBody(B,i);
-    simdvec mi = SIMD<simdvec,3,NSIMD>::setBody(B,i);
-    simdvec R2 = eps2;
-
-    simdvec x2 = B[i+1].X[0];
-    x2 -= xi;
-    simdvec y2 = B[i+1].X[1];
-    y2 -= yi;
-    simdvec z2 = B[i+1].X[2];
-    z2 -= zi;
-    simdvec mj = B[i+1].SRC;
-
-    simdvec xj = x2;
-    R2 += x2 * x2;
-    simdvec yj = y2;
-    R2 += y2 * y2;
-    simdvec zj = z2;
-    R2 += z2 * z2;
-    simdvec invR;
-
-    x2 = B[i+2].X[0];
-    y2 = B[i+2].X[1];
-    z2 = B[i+2].X[2];
-    for (int j=i+1; j<n-2; j++) {
-      invR = rsqrt(R2);
-      invR &= index < j;
-      invR &= R2 > zero;
-      R2 = eps2;
-      x2 -= xi;
-      y2 -= yi;
-      z2 -= zi;
-
-      mj *= invR * mi;
-      pot += mj;
-      B[j].TRG[0] += sum(mj);
-      invR = invR * invR * mj;
-      mj = B[j+1].SRC;
-
-      xj *= invR;
-      ax += xj;
-      B[j].TRG[1] -= sum(xj);
-      xj = x2;
-      R2 += x2 * x2;
-      x2 = B[j+2].X[0];
-
-      yj *= invR;
-      ay += yj;
-      B[j].TRG[2] -= sum(yj);
-      yj = y2;
-      R2 += y2 * y2;
-      y2 = B[j+2].X[1];
-
-      zj *= invR;
-      az += zj;
-      B[j].TRG[3] -= sum(zj);
-      zj = z2;
-      R2 += z2 * z2;
-      z2 = B[j+2].X[2];
-    }
-    if ( n-2 > i ) {
-      invR = rsqrt(R2);
-      invR &= index < n-2;
-      invR &= R2 > zero;
-      R2 = eps2;
-      x2 -= xi;
-      y2 -= yi;
-      z2 -= zi;
-
-      mj *= invR * mi;
-      pot += mj;
-      B[n-2].TRG[0] += sum(mj);
-      invR = invR * invR * mj;
-      mj = B[n-1].SRC;
-
-      xj *= invR;
-      ax += xj;
-      B[n-2].TRG[1] -= sum(xj);
-      xj = x2;
-      R2 += x2 * x2;
-
-      yj *= invR;
-      ay += yj;
-      B[n-2].TRG[2] -= sum(yj);
-      yj = y2;
-      R2 += y2 * y2;
-
-      zj *= invR;
-      az += zj;
-      B[n-2].TRG[3] -= sum(zj);
-      zj = z2;
-      R2 += z2 * z2;
-    }
-    invR = rsqrt(R2);
-    invR &= index < n-1;
-    invR &= R2 > zero;
-    mj *= invR * mi;
-    pot += mj;
-    B[n-1].TRG[0] += sum(mj);
-    invR = invR * invR * mj;
-
-    xj *= invR;
-    ax += xj;
-    B[n-1].TRG[1] -= sum(xj);
-    yj *= invR;
-    ay += yj;
-    B[n-1].TRG[2] -= sum(yj);
-    zj *= invR;
-    az += zj;
-    B[n-1].TRG[3] -= sum(zj);
-    for (int k=0; k<NSIMD; k++) {
-      B[i+k].TRG[0] += transpose(pot,k);
-      B[i+k].TRG[1] += transpose(ax,k);
-      B[i+k].TRG[2] += transpose(ay,k);
-      B[i+k].TRG[3] += transpose(az,k);
-    }
-  }
+  if (eps2 != 0) P2PMutual<true,true,false>(B, n, B, n, eps2, 0.0);
+  else P2PMutual<true,false,false>(B, n, B, n, eps2, 0.0);
+  return;
 #endif
   for ( ; i<n; i++) {
     kreal_t pot = 0;
@@ -329,3 +735,27 @@ void kernel::P2P(C_iter C, real_t eps2) {
     B[i].TRG[3] -= az;
   }
 }
+#endif
+
+kernel::P2PKernel kernel::P2PVariant(bool soft, bool periodic, bool mutual) {
+  static const P2PKernel variants[8] = {
+    P2PPair<false,false,false>, P2PPair<false,false,true>,
+    P2PPair<false,true,false>,  P2PPair<false,true,true>,
+    P2PPair<true,false,false>,  P2PPair<true,false,true>,
+    P2PPair<true,true,false>,   P2PPair<true,true,true>
+  };
+  return variants[4 * soft + 2 * periodic + mutual];
+}
+
+void kernel::P2P(C_iter Ci, C_iter Cj, real_t eps2, vec3 Xperiodic, bool mutual) {
+  P2PVariant(eps2 != 0, norm(Xperiodic) != 0, mutual)(Ci, Cj, eps2, Xperiodic);
+}
+
+//! About 20 flops per body pair with the reciprocal square root counted as one
+double kernel::P2POps() {
+#if USE_SIMD
+  return 20. / NSIMD;
+#else
+  return 20.;
+#endif
+}
@@ -0,0 +1,154 @@
+#include "LaplaceSphericalCPU.cxx"
+#include <limits>
+#include <map>
+
+const int NWIGNER = P*(2*P-1)*(2*P+1)/3;                        // Number of rotation matrix entries for all n<P
+
+//! Rotation matrices of the solid harmonics for one polar angle
+struct Wigner {
+  ereal_t D[NWIGNER];                                           //!< D[n][m+n][k+n] for -n<=m,k<=n
+};
+typedef std::map<int64_t,Wigner*> WignerMap;                    // Map of quantized cos(theta) to rotation matrices
+
+static __thread WignerMap * wignerMap = NULL;                   // Rotation matrices cached per direction (one cache per thread)
+const size_t maxWigner = (size_t(32) << 20) / sizeof(Wigner);   // Limit cache to 32MB per thread
+const ereal_t wignerScale = 1 / (16 * std::numeric_limits<real_t>::epsilon());// Key resolution just above rounding noise of dX
+
+//! Offset of order n in the rotation matrices
+inline int wignerOffset(int n) {
+  return n * (2 * n - 1) * (2 * n + 1) / 3;
+}
+
+//! Rotation about the y axis by beta \f$ Y_n^m(R_y(\beta) x) = \sum_k D_{mk} Y_n^k(x) \f$
+void evalWigner(double beta, ereal_t * D) {
+  double fact[2*P];                                             // Factorials
+  double cpow[2*P], spow[2*P];                                  // Powers of cos(beta/2) and sin(beta/2)
+  fact[0] = cpow[0] = spow[0] = 1;                              // Initialize 0! and 0th powers
+  for (int i=1; i<2*P; i++) {                                   // Loop over table entries
+    fact[i] = fact[i-1] * i;                                    //  i!
+    cpow[i] = cpow[i-1] * std::cos(beta / 2);                   //  cos(beta/2)^i
+    spow[i] = spow[i-1] * std::sin(beta / 2);                   //  sin(beta/2)^i
+  }                                                             // End loop over table entries
+  for (int n=0; n<P; n++) {                                     // Loop over n
+    ereal_t * Dn = D + wignerOffset(n);                         //  Matrix of order n
+    for (int m=-n; m<=n; m++) {                                 //  Loop over rows
+      for (int k=-n; k<=n; k++) {                               //   Loop over columns
+        double d = 0;                                           //    Wigner small d for (n,m,k)
+        for (int s=std::max(0,k-m); s<=std::min(n+k,n-m); s++) {//    Loop over terms
+          d += ODDEVEN(m-k+s) * cpow[2*n+k-m-2*s] * spow[m-k+2*s]
+            / (fact[n+k-s] * fact[s] * fact[m-k+s] * fact[n-m-s]);
+        }                                                       //    End loop over terms
+        d *= fact[n+k] * fact[n-k];                             //    Scale from normalized to exafmm harmonics
+        if (m < 0) d *= ODDEVEN(m);                             //    Conjugate relation for m < 0
+        if (k < 0) d *= ODDEVEN(k);                             //    Conjugate relation for k < 0
+        Dn[(m+n)*(2*n+1)+k+n] = d;                              //    Store matrix entry
+      }                                                         //   End loop over columns
+    }                                                           //  End loop over rows
+  }                                                             // End loop over n
+}
+
+//! Get rotation matrices that bring the polar angle theta to the z axis (cached by quantized cos(theta))
+const ereal_t * getWigner(ereal_t cosTheta, ereal_t theta, ereal_t * buffer) {
+  if (!wignerMap) wignerMap = new WignerMap;                    // Create cache of this thread on first use
+  int64_t key = int64_t(std::floor(cosTheta * wignerScale + .5));// Nearly equal angles share one entry
+  WignerMap::iterator W = wignerMap->find(key);                 // Look up direction
+  if (W != wignerMap->end()) return W->second->D;               // Return cached matrices
+  evalWigner(-theta, buffer);                                   // Compute matrices in buffer
+  if (wignerMap->size() < maxWigner) {                          // If there is room in cache
+    Wigner * Wnew = new Wigner;                                 //  Allocate cache entry
+    std::copy(buffer, buffer+NWIGNER, Wnew->D);                 //  Copy matrices
+    (*wignerMap)[key] = Wnew;                                   //  Add to cache
+  }                                                             // End if for room in cache
+  return buffer;                                                // Return computed matrices
+}
+
+//! Rotate coefficients of order n<p into the frame where the translation is along z
+void rotateForward(const vecP & M, vecP & Mr, const ereal_t * D, const ecomplex_t * eim, int p) {
+  ecomplex_t Mk[P];                                             // Coefficients of one order with phase applied
+  for (int n=0; n<p; n++) {                                     // Loop over n
+    const ereal_t * Dn = D + wignerOffset(n);                   //  Matrix of order n
+    for (int k=0; k<=n; k++) Mk[k] = M[n*(n+1)/2+k] * eim[k];   //  Rotate about z
+    for (int m=0; m<=n; m++) {                                  //  Loop over m
+      const ereal_t * row = Dn + (m + n) * (2 * n + 1) + n;     //   Row m centered at k=0
+      ecomplex_t sum = row[0] * Mk[0];                          //   k = 0 term
+      for (int k=1; k<=n; k++) {                                //   Loop over k
+        sum += row[k] * Mk[k] + row[-k] * std::conj(Mk[k]);     //    k and -k terms
+      }                                                         //   End loop over k
+      Mr[n*(n+1)/2+m] = sum;                                    //   Rotated coefficient
+    }                                                           //  End loop over m
+  }                                                             // End loop over n
+}
+
+//! Rotate coefficients of order n<p back from the frame where the translation is along z and accumulate
+void rotateBack(const vecP & Lr, vecP & L, const ereal_t * D, const ecomplex_t * eim, int p) {
+  ecomplex_t Lm[P];                                             // Coefficients of one order
+  for (int n=0; n<p; n++) {                                     // Loop over n
+    const ereal_t * Dn = D + wignerOffset(n) + n * (2 * n + 1) + n;//  Matrix of order n centered at (0,0)
+    for (int m=0; m<=n; m++) Lm[m] = Lr[n*(n+1)/2+m];           //  Copy coefficients
+    for (int k=0; k<=n; k++) {                                  //  Loop over k
+      ecomplex_t sum = Dn[k] * Lm[0];                           //   m = 0 term
+      for (int m=1; m<=n; m++) {                                //   Loop over m
+        sum += Dn[m*(2*n+1)+k] * Lm[m] + Dn[-m*(2*n+1)+k] * std::conj(Lm[m]);// m and -m terms
+      }                                                         //   End loop over m
+      L[n*(n+1)/2+k] += sum * std::conj(eim[k]);                //   Rotate back about z
+    }                                                           //  End loop over k
+  }                                                             // End loop over n
+}
+
+void kernel::M2L(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
+  evec3 dX = evec3(Ci->X) - evec3(Cj->X) - evec3(Xperiodic);
+  ereal_t rho, alpha, beta;
+  cart2sph(rho, alpha, beta, dX);
+  ereal_t buffer[NWIGNER];
+  const ereal_t * D = getWigner(dX[2] / rho, alpha, buffer);
+  ecomplex_t eim[P];
+  eim[0] = 1;
+  ecomplex_t ei = std::exp(I * beta);
+  for (int m=1; m<P; m++) eim[m] = eim[m-1] * ei;
+  ereal_t Yn[P];
+  Yn[0] = 1 / rho;
+  for (int n=1; n<P; n++) Yn[n] = Yn[n-1] * n / rho;
+#if MASS
+  ereal_t Cnm = std::real(Ci->M[0] * Cj->M[0]);
+#else
+  ereal_t Cnm = 1;
+#endif
+  vecP Mr, Lr;
+  int p = Cj->ORDER;
+  rotateForward(Cj->M, Mr, D, eim, p);
+#if MASS
+  Mr[0] = 1;
+#endif
+  for (int j=0; j<p; j++) {
+    for (int k=0; k<=j; k++) {
+      ecomplex_t Li = 0;
+      for (int n=k; n<p-j; n++) {
+        Li += Mr[n*(n+1)/2+k] * Yn[j+n] * ereal_t(ODDEVEN(k+n));
+      }
+      Lr[j*(j+1)/2+k] = Cnm * Li;
+    }
+  }
+  rotateBack(Lr, Ci->L, D, eim, p);
+  if (mutual) {
+    p = Ci->ORDER;
+    rotateForward(Ci->M, Mr, D, eim, p);
+#if MASS
+    Mr[0] = 1;
+#endif
+    for (int j=0; j<p; j++) {
+      for (int k=0; k<=j; k++) {
+        ecomplex_t Lj = 0;
+        for (int n=k; n<p-j; n++) {
+          Lj += Mr[n*(n+1)/2+k] * Yn[j+n];
+        }
+        Lr[j*(j+1)/2+k] = Cnm * ereal_t(ODDEVEN(j+k)) * Lj;
+      }
+    }
+    rotateBack(Lr, Cj->L, D, eim, p);
+  }
+}
+
+//! Rotations to and from the z axis and the O(p^3) coaxial translation (rotation matrices are cached)
+double kernel::M2LOps(bool mutual) {
+  return mutual ? 8. * P * P * P + 250 : 4. * P * P * P + 250;
+}
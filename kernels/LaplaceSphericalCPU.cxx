@@ -3,18 +3,18 @@
 #define ODDEVEN(n) ((((n) & 1) == 1) ? -1 : 1)
 #define IPOW2N(n) ((n >= 0) ? 1 : ODDEVEN(n))
 
-const complex_t I(0.,1.);                                       // Imaginary unit
+const ecomplex_t I(0.,1.);                                      // Imaginary unit
 
 //! Get r,theta,phi from x,y,z
-void cart2sph(real_t & r, real_t & theta, real_t & phi, vec3 dX) {
+void cart2sph(ereal_t & r, ereal_t & theta, ereal_t & phi, evec3 dX) {
   r = sqrt(norm(dX));                                           // r = sqrt(x^2 + y^2 + z^2)
-  theta = r == 0 ? 0 : acos(dX[2] / r);                         // theta = acos(z / r)
+  theta = r == 0 ? 0 : acos(std::max(ereal_t(-1), std::min(ereal_t(1), dX[2] / r)));// theta = acos(z / r) (clamped against rounding)
   phi = atan2(dX[1], dX[0]);                                    // phi = atan(y / x)
 }
 
 //! Spherical to cartesian coordinates
 template<typename T>
-void sph2cart(real_t r, real_t theta, real_t phi, T spherical, T & cartesian) {
+void sph2cart(ereal_t r, ereal_t theta, ereal_t phi, T spherical, T & cartesian) {
   cartesian[0] = sin(theta) * cos(phi) * spherical[0]           // x component (not x itself)
     + cos(theta) * cos(phi) / r * spherical[1]
     - sin(phi) / r / sin(theta) * spherical[2];
@@ -26,32 +26,32 @@ void sph2cart(real_t r, real_t theta, real_t phi, T spherical, T & cartesian) {
 }
 
 //! Evaluate solid harmonics \f$ r^n Y_{n}^{m} \f$
-void evalMultipole(real_t rho, real_t alpha, real_t beta, complex_t * Ynm, complex_t * YnmTheta) {
-  real_t x = std::cos(alpha);                                   // x = cos(alpha)
-  real_t y = std::sin(alpha);                                   // y = sin(alpha)
-  real_t fact = 1;                                              // Initialize 2 * m + 1
-  real_t pn = 1;                                                // Initialize Legendre polynomial Pn
-  real_t rhom = 1;                                              // Initialize rho^m
-  complex_t ei = std::exp(I * beta);                            // exp(i * beta)
-  complex_t eim = 1.0;                                          // Initialize exp(i * m * beta)
+void evalMultipole(ereal_t rho, ereal_t alpha, ereal_t beta, ecomplex_t * Ynm, ecomplex_t * YnmTheta) {
+  ereal_t x = std::cos(alpha);                                  // x = cos(alpha)
+  ereal_t y = std::sin(alpha);                                  // y = sin(alpha)
+  ereal_t fact = 1;                                             // Initialize 2 * m + 1
+  ereal_t pn = 1;                                               // Initialize Legendre polynomial Pn
+  ereal_t rhom = 1;                                             // Initialize rho^m
+  ecomplex_t ei = std::exp(I * beta);                           // exp(i * beta)
+  ecomplex_t eim = 1.0;                                         // Initialize exp(i * m * beta)
   for (int m=0; m<P; m++) {                                     // Loop over m in Ynm
-    real_t p = pn;                                              //  Associated Legendre polynomial Pnm
+    ereal_t p = pn;                                             //  Associated Legendre polynomial Pnm
     int npn = m * m + 2 * m;                                    //  Index of Ynm for m > 0
     int nmn = m * m;                                            //  Index of Ynm for m < 0
     Ynm[npn] = rhom * p * eim;                                  //  rho^m * Ynm for m > 0
     Ynm[nmn] = std::conj(Ynm[npn]);                             //  Use conjugate relation for m < 0
-    real_t p1 = p;                                              //  Pnm-1
+    ereal_t p1 = p;                                             //  Pnm-1
     p = x * (2 * m + 1) * p1;                                   //  Pnm using recurrence relation
     YnmTheta[npn] = rhom * (p - (m + 1) * x * p1) / y * eim;    //  theta derivative of r^n * Ynm
     rhom *= rho;                                                //  rho^m
-    real_t rhon = rhom;                                         //  rho^n
+    ereal_t rhon = rhom;                                        //  rho^n
     for (int n=m+1; n<P; n++) {                                 //  Loop over n in Ynm
       int npm = n * n + n + m;                                  //   Index of Ynm for m > 0
       int nmm = n * n + n - m;                                  //   Index of Ynm for m < 0
       rhon /= -(n + m);                                         //   Update factorial
       Ynm[npm] = rhon * p * eim;                                //   rho^n * Ynm
       Ynm[nmm] = std::conj(Ynm[npm]);                           //   Use conjugate relation for m < 0
-      real_t p2 = p1;                                           //   Pnm-2
+      ereal_t p2 = p1;                                          //   Pnm-2
       p1 = p;                                                   //   Pnm-1
       p = (x * (2 * n + 1) * p1 - (n + m) * p2) / (n - m + 1);  //   Pnm using recurrence relation
       YnmTheta[npm] = rhon * ((n - m + 1) * p - (n + 1) * x * p1) / y * eim;// theta derivative
@@ -65,31 +65,31 @@ void evalMultipole(real_t rho, real_t alpha, real_t beta, complex_t * Ynm, compl
 }
 
 //! Evaluate singular harmonics \f$ r^{-n-1} Y_n^m \f$
-void evalLocal(real_t rho, real_t alpha, real_t beta, complex_t * Ynm) {
-  real_t x = std::cos(alpha);                                   // x = cos(alpha)
-  real_t y = std::sin(alpha);                                   // y = sin(alpha)
-  real_t fact = 1;                                              // Initialize 2 * m + 1
-  real_t pn = 1;                                                // Initialize Legendre polynomial Pn
-  real_t invR = -1.0 / rho;                                     // - 1 / rho
-  real_t rhom = -invR;                                          // Initialize rho^(-m-1)
-  complex_t ei = std::exp(I * beta);                            // exp(i * beta)
-  complex_t eim = 1.0;                                          // Initialize exp(i * m * beta)
+void evalLocal(ereal_t rho, ereal_t alpha, ereal_t beta, ecomplex_t * Ynm) {
+  ereal_t x = std::cos(alpha);                                  // x = cos(alpha)
+  ereal_t y = std::sin(alpha);                                  // y = sin(alpha)
+  ereal_t fact = 1;                                             // Initialize 2 * m + 1
+  ereal_t pn = 1;                                               // Initialize Legendre polynomial Pn
+  ereal_t invR = -1.0 / rho;                                    // - 1 / rho
+  ereal_t rhom = -invR;                                         // Initialize rho^(-m-1)
+  ecomplex_t ei = std::exp(I * beta);                           // exp(i * beta)
+  ecomplex_t eim = 1.0;                                         // Initialize exp(i * m * beta)
   for (int m=0; m<P; m++) {                                     // Loop over m in Ynm
-    real_t p = pn;                                              //  Associated Legendre polynomial Pnm
+    ereal_t p = pn;                                             //  Associated Legendre polynomial Pnm
     int npn = m * m + 2 * m;                                    //  Index of Ynm for m > 0
     int nmn = m * m;                                            //  Index of Ynm for m < 0
     Ynm[npn] = rhom * p * eim;                                  //  rho^(-m-1) * Ynm for m > 0
     Ynm[nmn] = std::conj(Ynm[npn]);                             //  Use conjugate relation for m < 0
-    real_t p1 = p;                                              //  Pnm-1
+    ereal_t p1 = p;                                             //  Pnm-1
     p = x * (2 * m + 1) * p1;                                   //  Pnm using recurrence relation
     rhom *= invR;                                               //  rho^(-m-1)
-    real_t rhon = rhom;                                         //  rho^(-n-1)
+    ereal_t rhon = rhom;                                        //  rho^(-n-1)
     for (int n=m+1; n<P; n++) {                                 //  Loop over n in Ynm
       int npm = n * n + n + m;                                  //   Index of Ynm for m > 0
       int nmm = n * n + n - m;                                  //   Index of Ynm for m < 0
       Ynm[npm] = rhon * p * eim;                                //   rho^n * Ynm for m > 0
       Ynm[nmm] = std::conj(Ynm[npm]);                           //   Use conjugate relation for m < 0
-      real_t p2 = p1;                                           //   Pnm-2
+      ereal_t p2 = p1;                                          //   Pnm-2
       p1 = p;                                                   //   Pnm-1
       p = (x * (2 * n + 1) * p1 - (n + m) * p2) / (n - m + 1);  //   Pnm using recurrence relation
       rhon *= invR * (n - m + 1);                               //   rho^(-n-1)
@@ -100,44 +100,165 @@ void evalLocal(real_t rho, real_t alpha, real_t beta, complex_t * Ynm) {
   }                                                             // End loop over m in Ynm
 }
 
+//! Get r, cos(theta), sin(theta) and exp(i phi) of NSIMDE vectors without trigonometric functions
+void cart2sph(esimdvec & r, esimdvec & x, esimdvec & y, esimdvec & eiRe, esimdvec & eiIm,
+              const vec<3,esimdvec> & dX) {
+  esimdvec zero = 0.0;                                          // Zero vector
+  esimdvec one = 1.0;                                           // Unit vector
+  esimdvec rxy2 = dX[0] * dX[0] + dX[1] * dX[1];                // x^2 + y^2
+  esimdvec r2 = rxy2 + dX[2] * dX[2];                           // x^2 + y^2 + z^2
+  r = sqrt(r2);                                                 // r = sqrt(x^2 + y^2 + z^2)
+  esimdvec rxy = sqrt(rxy2);                                    // Distance from z axis
+  esimdvec invR = one / r;                                      // 1 / r
+  invR &= r2 > zero;                                            // 0 at the origin
+  esimdvec invRxy = one / rxy;                                  // 1 / distance from z axis
+  invRxy &= rxy2 > zero;                                        // 0 on the z axis
+  esimdvec notOrigin = one;                                     // 1 except at the origin
+  notOrigin &= r2 > zero;                                       // 0 at the origin
+  esimdvec notAxis = one;                                       // 1 except on the z axis
+  notAxis &= rxy2 > zero;                                       // 0 on the z axis
+  x = dX[2] * invR + one - notOrigin;                           // cos(theta) (theta = 0 at the origin)
+  y = rxy * invR;                                               // sin(theta)
+  eiRe = dX[0] * invRxy + one - notAxis;                        // cos(phi) (phi = 0 on the z axis)
+  eiIm = dX[1] * invRxy;                                        // sin(phi)
+}
+
+//! Evaluate solid harmonics \f$ r^n Y_{n}^{m} \f$ (m >= 0) of NSIMDE bodies from cos(alpha), sin(alpha) and exp(i beta)
+void evalMultipole(esimdvec rho, esimdvec x, esimdvec y, esimdvec eiRe, esimdvec eiIm,
+                   esimdvec * YnmRe, esimdvec * YnmIm, esimdvec * YnmThetaRe, esimdvec * YnmThetaIm) {
+  esimdvec invY = esimdvec(1.0) / y;                            // 1 / sin(alpha) for theta derivatives
+  ereal_t fact = 1;                                             // Initialize 2 * m + 1
+  esimdvec pn = 1.0;                                            // Initialize Legendre polynomial Pn
+  esimdvec rhom = 1.0;                                          // Initialize rho^m
+  esimdvec eimRe = 1.0;                                         // Initialize exp(i * m * beta)
+  esimdvec eimIm = 0.0;                                         // Imaginary part
+  for (int m=0; m<P; m++) {                                     // Loop over m in Ynm
+    esimdvec p = pn;                                            //  Associated Legendre polynomial Pnm
+    int npn = m * m + 2 * m;                                    //  Index of Ynm for m > 0
+    esimdvec t = rhom * p;                                      //  rho^m * Pnm
+    YnmRe[npn] = t * eimRe;                                     //  rho^m * Ynm for m > 0
+    YnmIm[npn] = t * eimIm;
+    esimdvec p1 = p;                                            //  Pnm-1
+    p = x * esimdvec(ereal_t(2 * m + 1)) * p1;                  //  Pnm using recurrence relation
+    if (YnmThetaRe) {                                           //  If theta derivatives are needed
+      t = rhom * (p - esimdvec(ereal_t(m + 1)) * x * p1) * invY;//   theta derivative of r^n * Ynm
+      YnmThetaRe[npn] = t * eimRe;
+      YnmThetaIm[npn] = t * eimIm;
+    }                                                           //  End if for theta derivatives
+    rhom *= rho;                                                //  rho^m
+    esimdvec rhon = rhom;                                       //  rho^n
+    for (int n=m+1; n<P; n++) {                                 //  Loop over n in Ynm
+      int npm = n * n + n + m;                                  //   Index of Ynm for m > 0
+      rhon *= esimdvec(ereal_t(-1) / (n + m));                  //   Update factorial
+      t = rhon * p;                                             //   rho^n * Pnm
+      YnmRe[npm] = t * eimRe;                                   //   rho^n * Ynm
+      YnmIm[npm] = t * eimIm;
+      esimdvec p2 = p1;                                         //   Pnm-2
+      p1 = p;                                                   //   Pnm-1
+      p = (x * esimdvec(ereal_t(2 * n + 1)) * p1 - esimdvec(ereal_t(n + m)) * p2)
+        * esimdvec(ereal_t(1) / (n - m + 1));                   //   Pnm using recurrence relation
+      if (YnmThetaRe) {                                         //   If theta derivatives are needed
+        t = rhon * (esimdvec(ereal_t(n - m + 1)) * p - esimdvec(ereal_t(n + 1)) * x * p1) * invY;// theta derivative
+        YnmThetaRe[npm] = t * eimRe;
+        YnmThetaIm[npm] = t * eimIm;
+      }                                                         //   End if for theta derivatives
+      rhon *= rho;                                              //   Update rho^n
+    }                                                           //  End loop over n in Ynm
+    rhom *= esimdvec(ereal_t(-1) / ((2 * m + 2) * (2 * m + 1)));//  Update factorial
+    pn = -pn * esimdvec(fact) * y;                              //  Pn
+    fact += 2;                                                  //  2 * m + 1
+    esimdvec re = eimRe * eiRe - eimIm * eiIm;                  //  Update exp(i * m * beta)
+    eimIm = eimRe * eiIm + eimIm * eiRe;
+    eimRe = re;
+  }                                                             // End loop over m in Ynm
+}
+
+//! Evaluate singular harmonics \f$ r^{-n-1} Y_n^m \f$ (m >= 0) of NSIMDE bodies from cos(alpha), sin(alpha) and exp(i beta)
+void evalLocal(esimdvec rho, esimdvec x, esimdvec y, esimdvec eiRe, esimdvec eiIm,
+               esimdvec * YnmRe, esimdvec * YnmIm) {
+  ereal_t fact = 1;                                             // Initialize 2 * m + 1
+  esimdvec pn = 1.0;                                            // Initialize Legendre polynomial Pn
+  esimdvec invR = -esimdvec(1.0) / rho;                         // - 1 / rho
+  esimdvec rhom = -invR;                                        // Initialize rho^(-m-1)
+  esimdvec eimRe = 1.0;                                         // Initialize exp(i * m * beta)
+  esimdvec eimIm = 0.0;                                         // Imaginary part
+  for (int m=0; m<P; m++) {                                     // Loop over m in Ynm
+    esimdvec p = pn;                                            //  Associated Legendre polynomial Pnm
+    int npn = m * m + 2 * m;                                    //  Index of Ynm for m > 0
+    esimdvec t = rhom * p;                                      //  rho^(-m-1) * Pnm
+    YnmRe[npn] = t * eimRe;                                     //  rho^(-m-1) * Ynm for m > 0
+    YnmIm[npn] = t * eimIm;
+    esimdvec p1 = p;                                            //  Pnm-1
+    p = x * esimdvec(ereal_t(2 * m + 1)) * p1;                  //  Pnm using recurrence relation
+    rhom *= invR;                                               //  rho^(-m-1)
+    esimdvec rhon = rhom;                                       //  rho^(-n-1)
+    for (int n=m+1; n<P; n++) {                                 //  Loop over n in Ynm
+      int npm = n * n + n + m;                                  //   Index of Ynm for m > 0
+      t = rhon * p;                                             //   rho^(-n-1) * Pnm
+      YnmRe[npm] = t * eimRe;                                   //   rho^(-n-1) * Ynm for m > 0
+      YnmIm[npm] = t * eimIm;
+      esimdvec p2 = p1;                                         //   Pnm-2
+      p1 = p;                                                   //   Pnm-1
+      p = (x * esimdvec(ereal_t(2 * n + 1)) * p1 - esimdvec(ereal_t(n + m)) * p2)
+        * esimdvec(ereal_t(1) / (n - m + 1));                   //   Pnm using recurrence relation
+      rhon *= invR * esimdvec(ereal_t(n - m + 1));              //   rho^(-n-1)
+    }                                                           //  End loop over n in Ynm
+    pn = -pn * esimdvec(fact) * y;                              //  Pn
+    fact += 2;                                                  //  2 * m + 1
+    esimdvec re = eimRe * eiRe - eimIm * eiIm;                  //  Update exp(i * m * beta)
+    eimIm = eimRe * eiIm + eimIm * eiRe;
+    eimRe = re;
+  }                                                             // End loop over m in Ynm
+}
+
 void kernel::P2M(C_iter C) {
-  complex_t Ynm[P*P], YnmTheta[P*P];
-  for (B_iter B=C->BODY; B!=C->BODY+C->NBODY; B++) {
-    vec3 dX = B->X - C->X;
-    real_t rho, alpha, beta;
-    cart2sph(rho, alpha, beta, dX);
-    evalMultipole(rho, alpha, beta, Ynm, YnmTheta);
+  esimdvec YnmRe[P*P], YnmIm[P*P], MRe[NTERM], MIm[NTERM];
+  for (int nms=0; nms<NTERM; nms++) MRe[nms] = MIm[nms] = 0.0;
+  for (int i=0; i<C->NBODY; i+=NSIMDE) {
+    vec<3,esimdvec> dX;
+    esimdvec src;
+    for (int k=0; k<NSIMDE; k++) {
+      B_iter B = C->BODY + std::min(i + k, C->NBODY - 1);
+      evec3 dXk = evec3(B->X) - evec3(C->X);
+      for (int d=0; d<3; d++) dX[d][k] = dXk[d];
+      src[k] = i + k < C->NBODY ? ereal_t(B->SRC) : 0;
+    }
+    esimdvec rho, x, y, eiRe, eiIm;
+    cart2sph(rho, x, y, eiRe, eiIm, dX);
+    evalMultipole(rho, x, y, eiRe, eiIm, YnmRe, YnmIm, NULL, NULL);
     for (int n=0; n<P; n++) {
       for (int m=0; m<=n; m++) {
-        int nm  = n * n + n - m;
+        int nm  = n * n + n + m;
         int nms = n * (n + 1) / 2 + m;
-        C->M[nms] += B->SRC * Ynm[nm];
+        MRe[nms] += src * YnmRe[nm];
+        MIm[nms] -= src * YnmIm[nm];
       }
     }
   }
+  for (int nms=0; nms<NTERM; nms++) C->M[nms] += ecomplex_t(sum(MRe[nms]), sum(MIm[nms]));
 }
 
 void kernel::M2M(C_iter Ci, C_iter C0) {
-  complex_t Ynm[P*P], YnmTheta[P*P];
+  ecomplex_t Ynm[P*P], YnmTheta[P*P];
   for (C_iter Cj=C0+Ci->ICHILD; Cj!=C0+Ci->ICHILD+Ci->NCHILD; Cj++) {
-    vec3 dX = Ci->X - Cj->X;
-    real_t rho, alpha, beta;
+    evec3 dX = evec3(Ci->X) - evec3(Cj->X);
+    ereal_t rho, alpha, beta;
     cart2sph(rho, alpha, beta, dX);
     evalMultipole(rho, alpha, beta, Ynm, YnmTheta);
     for (int j=0; j<P; j++) {
       for (int k=0; k<=j; k++) {
         int jks = j * (j + 1) / 2 + k;
-        complex_t M = 0;
+        ecomplex_t M = 0;
         for (int n=0; n<=j; n++) {
           for (int m=std::max(-n,-j+k+n); m<=std::min(k-1,n); m++) {
             int jnkms = (j - n) * (j - n + 1) / 2 + k - m;
             int nm    = n * n + n - m;
-            M += Cj->M[jnkms] * Ynm[nm] * real_t(IPOW2N(m) * ODDEVEN(n));
+            M += Cj->M[jnkms] * Ynm[nm] * ereal_t(IPOW2N(m) * ODDEVEN(n));
           }
           for (int m=k; m<=std::min(n,j+k-n); m++) {
             int jnkms = (j - n) * (j - n + 1) / 2 - k + m;
             int nm    = n * n + n - m;
-            M += std::conj(Cj->M[jnkms]) * Ynm[nm] * real_t(ODDEVEN(k+n+m));
+            M += std::conj(Cj->M[jnkms]) * Ynm[nm] * ereal_t(ODDEVEN(k+n+m));
           }
         }
         Ci->M[jks] += M;
@@ -146,29 +267,36 @@ void kernel::M2M(C_iter Ci, C_iter C0) {
   }
 }
 
+#if Spherical
 void kernel::M2L(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
-  complex_t Ynmi[P*P], Ynmj[P*P];
-  vec3 dX = Ci->X - Cj->X - Xperiodic;
-  real_t rho, alpha, beta;
+  if (mutual && Ci->ORDER != Cj->ORDER) {
+    kernel::M2L(Ci, Cj, Xperiodic, false);
+    kernel::M2L(Cj, Ci, -Xperiodic, false);
+    return;
+  }
+  const int p = Cj->ORDER;
+  ecomplex_t Ynmi[P*P], Ynmj[P*P];
+  evec3 dX = evec3(Ci->X) - evec3(Cj->X) - evec3(Xperiodic);
+  ereal_t rho, alpha, beta;
   cart2sph(rho, alpha, beta, dX);
   evalLocal(rho, alpha, beta, Ynmi);
   if (mutual) evalLocal(rho, alpha+M_PI, beta, Ynmj);
-  for (int j=0; j<P; j++) {
+  for (int j=0; j<p; j++) {
 #if MASS
-    real_t Cnm = std::real(Ci->M[0] * Cj->M[0]) * ODDEVEN(j);
+    ereal_t Cnm = std::real(Ci->M[0] * Cj->M[0]) * ODDEVEN(j);
 #else
-    real_t Cnm = ODDEVEN(j);
+    ereal_t Cnm = ODDEVEN(j);
 #endif
     for (int k=0; k<=j; k++) {
       int jks = j * (j + 1) / 2 + k;
-      complex_t Li = 0, Lj = 0;
+      ecomplex_t Li = 0, Lj = 0;
 #if MASS
       int jk = j * j + j - k;
       Li += Cnm * Ynmi[jk];
       if (mutual) Lj += Cnm * Ynmj[jk];
-      for (int n=1; n<P-j; n++) {
+      for (int n=1; n<p-j; n++) {
 #else
-      for (int n=0; n<P-j; n++) {
+      for (int n=0; n<p-j; n++) {
 #endif
         for (int m=-n; m<0; m++) {
           int nms  = n * (n + 1) / 2 - m;
@@ -179,7 +307,7 @@ void kernel::M2L(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
         for (int m=0; m<=n; m++) {
           int nms  = n * (n + 1) / 2 + m;
           int jnkm = (j + n) * (j + n) + j + n + m - k;
-          real_t Cnm2 = Cnm * ODDEVEN((k-m)*(k<m)+m);
+          ereal_t Cnm2 = Cnm * ODDEVEN((k-m)*(k<m)+m);
           Li += Cj->M[nms] * Cnm2 * Ynmi[jnkm];
           if (mutual) Lj += Ci->M[nms] * Cnm2 * Ynmj[jnkm];
         }
@@ -189,12 +317,119 @@ void kernel::M2L(C_iter Ci, C_iter Cj, vec3 Xperiodic, bool mutual) {
     }
   }
 }
+#endif
+
+void kernel::M2L(C_iter Ci, const C_iter * Cj, const vec3 * Xperiodic, int numCj) {
+  for (int j=0; j<numCj; j++) {
+    kernel::M2L(Ci, Cj[j], Xperiodic[j], false);
+  }
+}
+
+void kernel::M2P(C_iter Ci, C_iter Cj, vec3 Xperiodic) {
+  esimdvec YnmRe[P*P], YnmIm[P*P];
+  for (int i=0; i<Ci->NBODY; i+=NSIMDE) {
+    vec<3,esimdvec> dX;
+    for (int k=0; k<NSIMDE; k++) {
+      B_iter B = Ci->BODY + std::min(i + k, Ci->NBODY - 1);
+      evec3 dXk = evec3(B->X) - evec3(Cj->X) - evec3(Xperiodic);
+      for (int d=0; d<3; d++) dX[d][k] = dXk[d];
+    }
+    esimdvec rho, x, y, eiRe, eiIm;
+    cart2sph(rho, x, y, eiRe, eiIm, dX);
+    evalLocal(rho, x, y, eiRe, eiIm, YnmRe, YnmIm);
+    esimdvec LRe[3], LIm[3];
+    for (int j=0; j<2; j++) {
+#if MASS
+      ereal_t Cnm = std::real(Cj->M[0]) * ODDEVEN(j);
+#else
+      ereal_t Cnm = ODDEVEN(j);
+#endif
+      for (int k=0; k<=j; k++) {
+        int jks = j * (j + 1) / 2 + k;
+        LRe[jks] = LIm[jks] = 0.0;
+#if MASS
+        LRe[jks] += esimdvec(Cnm) * YnmRe[j*j+j+k];             //  Cnm * Y_j^{-k} = Cnm * conj(Y_j^k)
+        LIm[jks] -= esimdvec(Cnm) * YnmIm[j*j+j+k];
+        for (int n=1; n<Cj->ORDER-j; n++) {
+#else
+        for (int n=0; n<Cj->ORDER-j; n++) {
+#endif
+          for (int m=-n; m<=n; m++) {
+            ecomplex_t M = m < 0 ? std::conj(Cj->M[n*(n+1)/2-m]) : Cj->M[n*(n+1)/2+m] * ereal_t(ODDEVEN((k-m)*(k<m)+m));
+            M *= Cnm;
+            int jnkm = (j + n) * (j + n) + j + n + std::abs(m - k);// Index of Y_{j+n}^{|m-k|}
+            esimdvec YIm = m < k ? -YnmIm[jnkm] : YnmIm[jnkm];  //     Y_n^{-m} = conj(Y_n^m)
+            LRe[jks] += esimdvec(std::real(M)) * YnmRe[jnkm] - esimdvec(std::imag(M)) * YIm;
+            LIm[jks] += esimdvec(std::real(M)) * YIm + esimdvec(std::imag(M)) * YnmRe[jnkm];
+          }
+        }
+      }
+    }
+    for (int k=0; k<NSIMDE && i+k<Ci->NBODY; k++) {
+      B_iter B = Ci->BODY + i + k;
+      B->TRG[0] += B->SRC * LRe[0][k];                          // Local expansion at the body itself
+      B->TRG[1] += B->SRC * LRe[2][k];                          // r Y_1^1 = (x + iy) / 2
+      B->TRG[2] -= B->SRC * LIm[2][k];
+      B->TRG[3] -= B->SRC * LRe[1][k];                          // r Y_1^0 = -z
+    }
+  }
+}
+
+void kernel::P2L(C_iter Ci, C_iter Cj, vec3 Xperiodic) {
+  esimdvec YnmRe[P*P], YnmIm[P*P], LRe[NTERM], LIm[NTERM];
+  for (int jks=0; jks<NTERM; jks++) LRe[jks] = LIm[jks] = 0.0;
+  for (int i=0; i<Cj->NBODY; i+=NSIMDE) {
+    vec<3,esimdvec> dX;
+    esimdvec Cnm;
+    for (int k=0; k<NSIMDE; k++) {
+      B_iter B = Cj->BODY + std::min(i + k, Cj->NBODY - 1);
+      evec3 dXk = evec3(Ci->X) - evec3(B->X) - evec3(Xperiodic);
+      for (int d=0; d<3; d++) dX[d][k] = dXk[d];
+#if MASS
+      Cnm[k] = i + k < Cj->NBODY ? ereal_t(B->SRC) * std::real(Ci->M[0]) : 0;
+#else
+      Cnm[k] = i + k < Cj->NBODY ? ereal_t(B->SRC) : 0;
+#endif
+    }
+    esimdvec rho, x, y, eiRe, eiIm;
+    cart2sph(rho, x, y, eiRe, eiIm, dX);
+    evalLocal(rho, x, y, eiRe, eiIm, YnmRe, YnmIm);
+    for (int j=0; j<Cj->ORDER; j++) {
+      esimdvec C = Cnm * esimdvec(ereal_t(ODDEVEN(j)));
+      for (int k=0; k<=j; k++) {
+        int jks = j * (j + 1) / 2 + k;
+        LRe[jks] += C * YnmRe[j*j+j+k];
+        LIm[jks] -= C * YnmIm[j*j+j+k];
+      }
+    }
+  }
+  for (int jks=0; jks<Cj->ORDER*(Cj->ORDER+1)/2; jks++) Ci->L[jks] += ecomplex_t(sum(LRe[jks]), sum(LIm[jks]));
+}
+
+#if Spherical
+//! Singular harmonics and the O(p^4) sum over (j,k,n,m)
+double kernel::M2LOps(bool mutual) {
+  double terms = 0;                                             // Complex multiply-adds of the sum
+  for (int j=0; j<P; j++) terms += (j + 1.) * (P - j) * (P - j);
+  return mutual ? 8 * terms + 300 : 5 * terms + 150;
+}
+#endif
+
+//! Singular harmonics and the two lowest local orders, NSIMDE target bodies at a time
+double kernel::M2POps(int numBodies) {
+  return (numBodies + NSIMDE - 1) / NSIMDE * 18. * P * P;
+}
+
+//! Singular harmonics accumulated into the local expansion, NSIMDE source bodies at a time
+double kernel::P2LOps(int numBodies) {
+  return (numBodies + NSIMDE - 1) / NSIMDE * (11. * P * P + 30);
+}
 
 void kernel::L2L(C_iter Ci, C_iter C0) {
-  complex_t Ynm[P*P], YnmTheta[P*P];
+  ecomplex_t Ynm[P*P], YnmTheta[P*P];
   C_iter Cj = C0 + Ci->IPARENT;
-  vec3 dX = Ci->X - Cj->X;
-  real_t rho, alpha, beta;
+  evec3 dX = evec3(Ci->X) - evec3(Cj->X);
+  ereal_t rho, alpha, beta;
   cart2sph(rho, alpha, beta, dX);
   evalMultipole(rho, alpha, beta, Ynm, YnmTheta);
 #if MASS
@@ -203,18 +438,18 @@ void kernel::L2L(C_iter Ci, C_iter C0) {
   for (int j=0; j<P; j++) {
     for (int k=0; k<=j; k++) {
       int jks = j * (j + 1) / 2 + k;
-      complex_t L = 0;
+      ecomplex_t L = 0;
       for (int n=j; n<P; n++) {
         for (int m=j+k-n; m<0; m++) {
           int jnkm = (n - j) * (n - j) + n - j + m - k;
           int nms  = n * (n + 1) / 2 - m;
-          L += std::conj(Cj->L[nms]) * Ynm[jnkm] * real_t(ODDEVEN(k));
+          L += std::conj(Cj->L[nms]) * Ynm[jnkm] * ereal_t(ODDEVEN(k));
         }
         for (int m=0; m<=n; m++) {
           if( n-j >= abs(m-k) ) {
             int jnkm = (n - j) * (n - j) + n - j + m - k;
             int nms  = n * (n + 1) / 2 + m;
-            L += Cj->L[nms] * Ynm[jnkm] * real_t(ODDEVEN((m-k)*(m<k)));
+            L += Cj->L[nms] * Ynm[jnkm] * ereal_t(ODDEVEN((m-k)*(m<k)));
           }
         }
       }
@@ -224,33 +459,44 @@ void kernel::L2L(C_iter Ci, C_iter C0) {
 }
 
 void kernel::L2P(C_iter Ci) {
-  complex_t Ynm[P*P], YnmTheta[P*P];
-  for (B_iter B=Ci->BODY; B!=Ci->BODY+Ci->NBODY; B++) {
-    vec3 dX = B->X - Ci->X;
-    vec3 spherical = 0;
-    vec3 cartesian = 0;
-    real_t r, theta, phi;
-    cart2sph(r, theta, phi, dX);
-    evalMultipole(r, theta, phi, Ynm, YnmTheta);
-    B->TRG /= B->SRC;
+  esimdvec YnmRe[P*P], YnmIm[P*P], YnmThetaRe[P*P], YnmThetaIm[P*P];
+  for (int i=0; i<Ci->NBODY; i+=NSIMDE) {
+    vec<3,esimdvec> dX;
+    for (int k=0; k<NSIMDE; k++) {
+      B_iter B = Ci->BODY + std::min(i + k, Ci->NBODY - 1);
+      evec3 dXk = evec3(B->X) - evec3(Ci->X);
+      for (int d=0; d<3; d++) dX[d][k] = dXk[d];
+    }
+    esimdvec r, x, y, eiRe, eiIm;
+    cart2sph(r, x, y, eiRe, eiIm, dX);
+    evalMultipole(r, x, y, eiRe, eiIm, YnmRe, YnmIm, YnmThetaRe, YnmThetaIm);
+    vec<3,esimdvec> spherical;
+    esimdvec pot = 0.0;
+    spherical = pot;
     for (int n=0; n<P; n++) {
-      int nm  = n * n + n;
-      int nms = n * (n + 1) / 2;
-      B->TRG[0] += std::real(Ci->L[nms] * Ynm[nm]);
-      spherical[0] += std::real(Ci->L[nms] * Ynm[nm]) / r * n;
-      spherical[1] += std::real(Ci->L[nms] * YnmTheta[nm]);
-      for( int m=1; m<=n; m++) {
-        nm  = n * n + n + m;
-        nms = n * (n + 1) / 2 + m;
-        B->TRG[0] += 2 * std::real(Ci->L[nms] * Ynm[nm]);
-        spherical[0] += 2 * std::real(Ci->L[nms] * Ynm[nm]) / r * n;
-        spherical[1] += 2 * std::real(Ci->L[nms] * YnmTheta[nm]);
-        spherical[2] += 2 * std::real(Ci->L[nms] * Ynm[nm] * I) * m;
+      for (int m=0; m<=n; m++) {
+        int nm  = n * n + n + m;
+        int nms = n * (n + 1) / 2 + m;
+        esimdvec LRe = std::real(Ci->L[nms]) * ereal_t(1 + (m > 0));// Terms with m > 0 count twice
+        esimdvec LIm = std::imag(Ci->L[nms]) * ereal_t(1 + (m > 0));
+        esimdvec LY = LRe * YnmRe[nm] - LIm * YnmIm[nm];        //   real(L * Ynm)
+        pot += LY;
+        spherical[0] += LY * esimdvec(ereal_t(n));
+        spherical[1] += LRe * YnmThetaRe[nm] - LIm * YnmThetaIm[nm];
+        spherical[2] -= (LRe * YnmIm[nm] + LIm * YnmRe[nm]) * esimdvec(ereal_t(m));
       }
     }
-    sph2cart(r, theta, phi, spherical, cartesian);
-    B->TRG[1] += cartesian[0];
-    B->TRG[2] += cartesian[1];
-    B->TRG[3] += cartesian[2];
+    esimdvec invR = esimdvec(1.0) / r;
+    spherical[0] *= invR;
+    vec<3,esimdvec> cartesian;                                  // Spherical to cartesian with cos, sin of theta and phi
+    cartesian[0] = y * eiRe * spherical[0] + x * eiRe * invR * spherical[1] - eiIm * invR / y * spherical[2];
+    cartesian[1] = y * eiIm * spherical[0] + x * eiIm * invR * spherical[1] + eiRe * invR / y * spherical[2];
+    cartesian[2] = x * spherical[0] - y * invR * spherical[1];
+    for (int k=0; k<NSIMDE && i+k<Ci->NBODY; k++) {
+      B_iter B = Ci->BODY + i + k;
+      B->TRG /= B->SRC;
+      B->TRG[0] += pot[k];
+      for (int d=0; d<3; d++) B->TRG[d+1] += cartesian[d][k];
+    }
   }
 }
@@ -5,6 +5,7 @@
 #include "ewald.h"
 #include "logger.h"
 #include "partition.h"
+#include "refit_tree.h"
 #include "traversal.h"
 #include "tree_mpi.h"
 #include "up_down_pass.h"
@@ -20,11 +21,16 @@ BaseMPI * baseMPI;
 BoundBox * boundBox;
 BuildTree * localTree, * globalTree;
 Partition * partition;
+RefitTree * refitTree;
 Traversal * traversal;
 TreeMPI * treeMPI;
 UpDownPass * upDownPass;
 
+const bool useRefit = false;
+
 Bodies buffer;
+Bodies treeBodies;
+Cells treeCells;
 Bounds localBounds;
 Bounds globalBounds;
 
@@ -40,6 +46,7 @@ extern "C" void fmm_init_(int & images, double & theta, int & verbose) {
   localTree = new BuildTree(ncrit, nspawn);
   globalTree = new BuildTree(1, nspawn);
   partition = new Partition(baseMPI->mpirank, baseMPI->mpisize);
+  refitTree = new RefitTree(ncrit);
   traversal = new Traversal(nspawn, images, eps2);
   treeMPI = new TreeMPI(baseMPI->mpirank, baseMPI->mpisize, images);
   upDownPass = new UpDownPass(theta, useRmax, useRopt);
@@ -64,6 +71,7 @@ extern "C" void fmm_finalize_() {
   delete localTree;
   delete globalTree;
   delete partition;
+  delete refitTree;
   delete traversal;
   delete treeMPI;
   delete upDownPass;
@@ -98,6 +106,7 @@ extern "C" void fmm_partition_(int & nglobal, int * icpumap, double * x, double
   globalBounds = baseMPI->allreduceBounds(localBounds);
   localBounds = partition->octsection(bodies,globalBounds);
   bodies = treeMPI->commBodies(bodies);
+  treeBodies.clear();
   for (int i=0; i<nglobal; i++) {
     icpumap[i] = 0;
   }
@@ -135,21 +144,35 @@ extern "C" void fmm_coulomb_(int & nglobal, int * icpumap,
   logger::printTitle("FMM Profiling");
   logger::startTimer("Total FMM");
   logger::startPAPI();
-  Bodies bodies(nlocal);
-  B_iter B = bodies.begin();
-  for (int i=0; i<nglobal; i++) {
-    if (icpumap[i] == 1) {
-      B->X[0] = x[3*i+0];
-      B->X[1] = x[3*i+1];
-      B->X[2] = x[3*i+2];
-      B->SRC = q[i];
-      B->TRG = 0;
-      int iwrap = wrap(B->X, cycle);
-      B->IBODY = i | (iwrap << shift);
-      B++;
+  Bodies & bodies = treeBodies;
+  bool refit = useRefit && int(bodies.size()) == nlocal;
+  for (B_iter B=bodies.begin(); B!=bodies.end() && refit; B++) {
+    refit = icpumap[B->IBODY & mask] == 1;
+  }
+  if (!refit) {
+    bodies.resize(nlocal);
+    B_iter B = bodies.begin();
+    for (int i=0; i<nglobal; i++) {
+      if (icpumap[i] == 1) {
+        B->IBODY = i;
+        B++;
+      }
     }
   }
-  Cells cells = localTree->buildTree(bodies, buffer, localBounds);
+  for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {
+    int i = B->IBODY & mask;
+    B->X[0] = x[3*i+0];
+    B->X[1] = x[3*i+1];
+    B->X[2] = x[3*i+2];
+    B->SRC = q[i];
+    B->TRG = 0;
+    int iwrap = wrap(B->X, cycle);
+    B->IBODY = i | (iwrap << shift);
+  }
+  Cells & cells = treeCells;
+  if (!refit || !refitTree->refitTree(bodies, buffer, cells, localBounds)) {
+    cells = localTree->buildTree(bodies, buffer, localBounds);
+  }
   upDownPass->upwardPass(cells);
   treeMPI->allgatherBounds(localBounds);
   treeMPI->setLET(cells, cycle);
@@ -187,8 +210,8 @@ extern "C" void fmm_coulomb_(int & nglobal, int * icpumap,
     f[3*i+1] += B->TRG[2] * B->SRC * Celec;
     f[3*i+2] += B->TRG[3] * B->SRC * Celec;
   }
-  bodies = treeMPI->getRecvBodies();
-  for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {
+  Bodies recvBodies = treeMPI->getRecvBodies();
+  for (B_iter B=recvBodies.begin(); B!=recvBodies.end(); B++) {
     int i = B->IBODY & mask;
     int iwrap = unsigned(B->IBODY) >> shift;
     unwrap(B->X, cycle, iwrap);
@@ -5,6 +5,7 @@
 #include "ewald.h"
 #include "logger.h"
 #include "partition.h"
+#include "refit_tree.h"
 #include "traversal.h"
 #include "tree_mpi.h"
 #include "up_down_pass.h"
@@ -17,11 +18,16 @@ BaseMPI * baseMPI;
 BoundBox * boundBox;
 BuildTree * localTree, * globalTree;
 Partition * partition;
+RefitTree * refitTree;
 Traversal * traversal;
 TreeMPI * treeMPI;
 UpDownPass * upDownPass;
 
+const bool useRefit = false;
+
 Bodies buffer;
+Bodies treeBodies;
+Cells treeCells;
 Bounds localBounds;
 Bounds globalBounds;
 
@@ -38,6 +44,7 @@ extern "C" void FMM_Init(int images) {
   localTree = new BuildTree(ncrit, nspawn);
   globalTree = new BuildTree(1, nspawn);
   partition = new Partition(baseMPI->mpirank, baseMPI->mpisize);
+  refitTree = new RefitTree(ncrit);
   traversal = new Traversal(nspawn, images, eps2);
   treeMPI = new TreeMPI(baseMPI->mpirank, baseMPI->mpisize, images);
   upDownPass = new UpDownPass(theta, useRmax, useRopt);
@@ -62,6 +69,7 @@ extern "C" void FMM_Finalize() {
   delete localTree;
   delete globalTree;
   delete partition;
+  delete refitTree;
   delete traversal;
   delete treeMPI;
   delete upDownPass;
@@ -85,6 +93,7 @@ extern "C" void FMM_Partition(int & n, int * index, double * x, double * q, doub
   globalBounds = baseMPI->allreduceBounds(localBounds);
   localBounds = partition->octsection(bodies,globalBounds);
   bodies = treeMPI->commBodies(bodies);
+  treeBodies.clear();
   Cells cells = localTree->buildTree(bodies, buffer, localBounds);
   upDownPass->upwardPass(cells);
 
@@ -108,9 +117,16 @@ extern "C" void FMM_Coulomb(int n, double * x, double * q, double * p, double *
   logger::printTitle("FMM Profiling");
   logger::startTimer("Total FMM");
   logger::startPAPI();
-  Bodies bodies(n);
+  Bodies & bodies = treeBodies;
+  bool refit = useRefit && int(bodies.size()) == n;
+  if (!refit) {
+    bodies.resize(n);
+    for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {
+      B->IBODY = B-bodies.begin();
+    }
+  }
   for (B_iter B=bodies.begin(); B!=bodies.end(); B++) {
-    int i = B-bodies.begin();
+    int i = B->IBODY;
     B->X[0] = x[3*i+0];
     B->X[1] = x[3*i+1];
     B->X[2] = x[3*i+2];
@@ -120,9 +136,11 @@ extern "C" void FMM_Coulomb(int n, double * x, double * q, double * p, double *
     B->TRG[1] = f[3*i+0];
     B->TRG[2] = f[3*i+1];
     B->TRG[3] = f[3*i+2];
-    B->IBODY = i;
   }
-  Cells cells = localTree->buildTree(bodies, buffer, localBounds);
+  Cells & cells = treeCells;
+  if (!refit || !refitTree->refitTree(bodies, buffer, cells, localBounds)) {
+    cells = localTree->buildTree(bodies, buffer, localBounds);
+  }
   upDownPass->upwardPass(cells);
   treeMPI->allgatherBounds(localBounds);
   treeMPI->setLET(cells, cycle);
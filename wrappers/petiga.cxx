@@ -15,6 +15,10 @@ Bodies bbodies;
 Bodies vbodies;
 Cells bcells;
 Cells vcells;
+std::vector<Traversal::Plan> plansB2B;
+std::vector<Traversal::Plan> plansV2B;
+std::vector<Traversal::Plan> plansB2V;
+std::vector<Traversal::Plan> plansV2V;
 
 Args * args;
 BaseMPI * baseMPI;
@@ -42,6 +46,16 @@ void log_finalize() {
   logger::printTime("Total FMM");
 }
 
+//! Traverse and record the interactions on the first call, replay them on later calls
+void traverse(std::vector<Traversal::Plan> & plans, int i, Cells & icells, Cells & jcells, bool mutual) {
+  if (int(plans.size()) <= i) {
+    plans.resize(i+1);
+    traversal->recordPlan(plans[i], icells, jcells, cycle, mutual);
+  } else {
+    traversal->replayPlan(plans[i], icells, jcells, cycle);
+  }
+}
+
 extern "C" void FMM_Init(double eps2, int ncrit, int threads,
 			 int nb, double * xb, double * yb, double * zb, double * vb,
 			 int nv, double * xv, double * yv, double * zv, double * vv) {
@@ -141,6 +155,10 @@ extern "C" void FMM_BuildTree() {
   bcells = localTree->buildTree(bbodies, buffer, localBoundsB);
   Bounds localBoundsV = boundBox->getBounds(vbodies);
   vcells = localTree->buildTree(vbodies, buffer, localBoundsV);
+  plansB2B.clear();
+  plansV2B.clear();
+  plansB2V.clear();
+  plansV2V.clear();
 }
 
 extern "C" void FMM_B2B(double * vi, double * vb, bool verbose) {
@@ -156,17 +174,17 @@ extern "C" void FMM_B2B(double * vi, double * vb, bool verbose) {
   treeMPI->commBodies();
   treeMPI->commCells();
   traversal->initWeight(bcells);
-  traversal->dualTreeTraversal(bcells, jcells, cycle, args->mutual);
+  traverse(plansB2B, 0, bcells, jcells, args->mutual);
   if (args->graft) {
     treeMPI->linkLET();
     Bodies gbodies = treeMPI->root2body();
     jcells = globalTree->buildTree(gbodies, buffer, globalBounds);
     treeMPI->attachRoot(jcells);
-    traversal->dualTreeTraversal(bcells, jcells, cycle, false);
+    traverse(plansB2B, 1, bcells, jcells, false);
   } else {
     for (int irank=0; irank<baseMPI->mpisize; irank++) {
       treeMPI->getLET(jcells, (baseMPI->mpirank+irank)%baseMPI->mpisize);
-      traversal->dualTreeTraversal(bcells, jcells, cycle, false);
+      traverse(plansB2B, 1+irank, bcells, jcells, false);
     }
   }
   upDownPass->downwardPass(bcells);
@@ -193,18 +211,18 @@ extern "C" void FMM_V2B(double * vb, double * vv, bool verbose) {
   treeMPI->commBodies();
   treeMPI->commCells();
   traversal->initWeight(bcells);
-  traversal->dualTreeTraversal(bcells, vcells, cycle, args->mutual);
+  traverse(plansV2B, 0, bcells, vcells, args->mutual);
   if (args->graft) {
     treeMPI->linkLET();
     Bodies gbodies = treeMPI->root2body();
     Cells jcells = globalTree->buildTree(gbodies, buffer, globalBounds);
     treeMPI->attachRoot(jcells);
-    traversal->dualTreeTraversal(bcells, jcells, cycle, false);
+    traverse(plansV2B, 1, bcells, jcells, false);
   } else {
     for (int irank=0; irank<baseMPI->mpisize; irank++) {
       Cells jcells;
       treeMPI->getLET(jcells, (baseMPI->mpirank+irank)%baseMPI->mpisize);
-      traversal->dualTreeTraversal(bcells, jcells, cycle, false);
+      traverse(plansV2B, 1+irank, bcells, jcells, false);
     }
   }
   upDownPass->downwardPass(bcells);
@@ -231,18 +249,18 @@ extern "C" void FMM_B2V(double * vv, double * vb, bool verbose) {
   treeMPI->commBodies();
   treeMPI->commCells();
   traversal->initWeight(vcells);
-  traversal->dualTreeTraversal(vcells, bcells, cycle, args->mutual);
+  traverse(plansB2V, 0, vcells, bcells, args->mutual);
   if (args->graft) {
     treeMPI->linkLET();
     Bodies gbodies = treeMPI->root2body();
     Cells jcells = globalTree->buildTree(gbodies, buffer, globalBounds);
     treeMPI->attachRoot(jcells);
-    traversal->dualTreeTraversal(vcells, jcells, cycle, false);
+    traverse(plansB2V, 1, vcells, jcells, false);
   } else {
     for (int irank=0; irank<baseMPI->mpisize; irank++) {
       Cells jcells;
       treeMPI->getLET(jcells, (baseMPI->mpirank+irank)%baseMPI->mpisize);
-      traversal->dualTreeTraversal(vcells, jcells, cycle, false);
+      traverse(plansB2V, 1+irank, vcells, jcells, false);
     }
   }
   upDownPass->downwardPass(vcells);
@@ -265,17 +283,17 @@ extern "C" void FMM_V2V(double * vi, double * vv, bool verbose) {
   treeMPI->commBodies();
   treeMPI->commCells();
   traversal->initWeight(vcells);
-  traversal->dualTreeTraversal(vcells, jcells, cycle, args->mutual);
+  traverse(plansV2V, 0, vcells, jcells, args->mutual);
   if (args->graft) {
     treeMPI->linkLET();
     Bodies gbodies = treeMPI->root2body();
     jcells = globalTree->buildTree(gbodies, buffer, globalBounds);
     treeMPI->attachRoot(jcells);
-    traversal->dualTreeTraversal(vcells, jcells, cycle, false);
+    traverse(plansV2V, 1, vcells, jcells, false);
   } else {
     for (int irank=0; irank<baseMPI->mpisize; irank++) {
       treeMPI->getLET(jcells, (baseMPI->mpirank+irank)%baseMPI->mpisize);
-      traversal->dualTreeTraversal(vcells, jcells, cycle, false);
+      traverse(plansV2V, 1+irank, vcells, jcells, false);
     }
   }
   upDownPass->downwardPass(vcells);
@@ -83,6 +83,15 @@ int main(int argc, char ** argv) {
   Direct(100, xb, yb, zb, vd, nb, xb, yb, zb, vb);
   Validate(100, vi, vd, mpirank == 0);
 
+  for (int i=0; i<nb; i++) {
+    vb[i] = drand48() / nb;
+    vi[i] = 0;
+    vd[i] = 0;
+  }
+  FMM_B2B(vi, vb, 1);
+  Direct(100, xb, yb, zb, vd, nb, xb, yb, zb, vb);
+  Validate(100, vi, vd, mpirank == 0);
+
   for (int i=0; i<nb; i++) {
     vb[i] = 0;
     vd[i] = 0;